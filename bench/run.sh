@@ -0,0 +1,126 @@
+#!/usr/bin/env bash
+# pushes every action of the cost matrix ITERATIONS times against a local nodeos and prints the
+# average cpu_usage_us and net_usage_words of the receipts and the average RAM delta of the payers.
+# needs cleos and jq, a wallet unlocked with the private key of KEY and the contract set on CONTRACT.
+#
+#   KEY=EOS6MRy... CONTRACT=tulip.token bench/run.sh                 # every case
+#   KEY=EOS6MRy... ITERATIONS=200 bench/run.sh claim recover         # some of them
+set -euo pipefail
+
+: "${KEY:?set KEY to the public key of the bench accounts}"
+CONTRACT=${CONTRACT:-tulip.token}
+ITERATIONS=${ITERATIONS:-1000}
+URL=${URL:-http://127.0.0.1:8888}
+CREATOR=${CREATOR:-eosio}
+ISSUER=${ISSUER:-benchissuer}
+HOLDER=${HOLDER:-benchholder}
+SYM=${SYM:-BEN}
+# part of every bench account name, a rerun on the same chain creates new accounts
+RUN=${RUN:-$(date +%s)}
+
+CASES=(new unclaimed claimed claim recover open close burn)
+
+cleos_() { cleos -u "$URL" "$@"; }
+
+quantity() { printf '%d.%04d %s' $(( $1 / 10000 )) $(( $1 % 10000 )) "$SYM"; }
+
+# bench account of a case and an iteration: b, the case letter, six letters of the run and four of the index
+acct() {
+   local n=$(( ( RUN % 26**6 ) * 26**4 + $2 )) s="" i
+   for (( i = 0; i < 10; i++ )); do
+      s=$(printf "\\$(printf '%03o' $(( 97 + n % 26 )))")$s
+      n=$(( n / 26 ))
+   done
+   echo "b$(printf "\\$(printf '%03o' $(( 97 + $1 )))")$s"
+}
+
+create_account() {
+   cleos_ get account "$1" >/dev/null 2>&1 || cleos_ create account "$CREATOR" "$1" "$KEY" >/dev/null
+}
+
+push() { cleos_ push action "$CONTRACT" "$1" "$2" -p "$3" >/dev/null; }
+
+# sum of ram_usage over the accounts that can pay for the rows of a case
+ram() {
+   local total=0 a
+   for a in "$@"; do
+      total=$(( total + $(cleos_ get account "$a" --json | jq .ram_usage) ))
+   done
+   echo "$total"
+}
+
+# the issuer holds the supply unclaimed, the holder claimed a share it sends from in the transfer cases
+setup_token() {
+   create_account "$ISSUER"
+   create_account "$HOLDER"
+   if [ "$(cleos_ get table "$CONTRACT" "$SYM" stat --json | jq '.rows | length')" = 0 ]; then
+      push create "[\"$ISSUER\", \"$(quantity 100000000000000)\"]" "$CONTRACT"
+   fi
+   push issue "[\"$ISSUER\", \"$(quantity 10000000000000)\", \"bench $RUN\"]" "$ISSUER"
+   push transfer "[\"$ISSUER\", \"$HOLDER\", \"$(quantity 1000000000000)\", \"bench $RUN\"]" "$ISSUER"
+   push claim "[\"$HOLDER\", \"4,$SYM\"]" "$HOLDER"
+}
+
+# sets up the rows of iteration $3 of case $1, the case number $2 names its accounts.
+# prints the measured action, its data, its authority and the accounts whose RAM it can change
+prepare() {
+   local r; r=$(acct "$2" "$3")
+   create_account "$r"
+   case $1 in
+      new)       ;;
+      unclaimed) push transfer "[\"$ISSUER\", \"$r\", \"$(quantity 10000)\", \"\"]" "$ISSUER" ;;
+      claimed)   push transfer "[\"$ISSUER\", \"$r\", \"$(quantity 10000)\", \"\"]" "$ISSUER"
+                 push claim "[\"$r\", \"4,$SYM\"]" "$r" ;;
+      claim|recover|burn)
+                 push transfer "[\"$ISSUER\", \"$r\", \"$(quantity 20000)\", \"\"]" "$ISSUER" ;;
+      open)      ;;
+      close)     push open "[\"$r\", \"4,$SYM\", \"$r\"]" "$r" ;;
+   esac
+   case $1 in
+      new|unclaimed|claimed)
+         line transfer "[\"$HOLDER\", \"$r\", \"$(quantity 10000)\", \"$3\"]" "$HOLDER" "$HOLDER $r" ;;
+      claim)   line claim "[\"$r\", \"4,$SYM\"]" "$r" "$r" ;;
+      recover) line recover "[\"$r\", \"4,$SYM\"]" "$ISSUER" "$r" ;;
+      open)    line open "[\"$r\", \"4,$SYM\", \"$r\"]" "$r" "$r" ;;
+      close)   line close "[\"$r\", \"4,$SYM\"]" "$r" "$r" ;;
+      burn)    line burn "[\"$r\", \"$(quantity 10000)\"]" "$ISSUER" "$r" ;;
+   esac
+}
+
+line() { printf '%s\t%s\t%s\t%s\n' "$@"; }
+
+run_case() {
+   local i fields action data auth payers before json after cpu=0 net=0 ramd=0
+   for (( i = 0; i < ITERATIONS; i++ )); do
+      fields=$(prepare "$1" "$2" "$i")
+      IFS=$'\t' read -r action data auth payers <<<"$fields"
+      # unclaimed rows are billed to the issuer and the stats rows to the contract
+      before=$(ram $payers "$ISSUER" "$CONTRACT")
+      json=$(cleos_ push action "$CONTRACT" "$action" "$data" -p "$auth" --json)
+      after=$(ram $payers "$ISSUER" "$CONTRACT")
+      cpu=$(( cpu + $(jq .processed.receipt.cpu_usage_us <<<"$json") ))
+      net=$(( net + $(jq .processed.receipt.net_usage_words <<<"$json") ))
+      ramd=$(( ramd + after - before ))
+   done
+   awk -v c="$1" -v n="$ITERATIONS" -v cpu="$cpu" -v net="$net" -v ram="$ramd" \
+      'BEGIN { printf "%-10s %8d %14.1f %16.2f %14.2f\n", c, n, cpu / n, net / n, ram / n }'
+}
+
+# the position of a case in CASES is its account letter
+case_number() {
+   local n
+   for n in "${!CASES[@]}"; do
+      [ "${CASES[$n]}" = "$1" ] && { echo "$n"; return; }
+   done
+   echo "unknown case $1, the cases are ${CASES[*]}" >&2
+   return 1
+}
+
+selected=("${CASES[@]}")
+[ $# -gt 0 ] && selected=("$@")
+for c in "${selected[@]}"; do case_number "$c" >/dev/null; done
+setup_token
+printf '%-10s %8s %14s %16s %14s\n' case runs cpu_usage_us net_usage_words ram_bytes
+for c in "${selected[@]}"; do
+   run_case "$c" "$(case_number "$c")"
+done
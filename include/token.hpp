@@ -5,7 +5,20 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
+#include <eosio/singleton.hpp>
+#include <eosio/system.hpp>
+
+#include "token_config.hpp"
+
+//table type of every token table, counted only in the TOKEN_DB_COUNTERS build
+#if TOKEN_DB_COUNTERS
+#include "token_counters.hpp"
+#define TOKEN_INDEX eosio::counted_index
+#else
+#define TOKEN_INDEX eosio::multi_index
+#endif
 
 
 namespace eosio {
@@ -16,33 +29,145 @@ namespace eosio {
 
       public:
          using contract::contract;
+         ~token();
 
          ACTION create( name issuer,
                       asset maximum_supply);
 
+#if TOKEN_UPDATE
          ACTION update( name issuer,
                       asset maximum_supply);
+#endif
 
          ACTION issue( const name& to, const asset& quantity, const string& memo );
          ACTION burn( name from, asset quantity );
          
          ACTION claim( name owner, const symbol& sym );
+#if TOKEN_BATCH_ACTIONS
+         ACTION claimmany( name payer, const std::vector<std::pair<name, symbol>>& balances );
+#endif
          
+#if TOKEN_RECOVER
          ACTION recover( name owner, const symbol& sym );
+#if TOKEN_BATCH_ACTIONS
+         ACTION recovermany( const symbol& sym, const std::vector<name>& owners );
+#endif
+#if TOKEN_UNCLAIMED_REGISTRY
+         ACTION sweep( const symbol& sym, uint32_t max_rows );
+#endif
+#endif
          
          ACTION transfer( const name&    from,
                       const name&    to,
                       const asset&   quantity,
                       const string&  memo );
 
+#if TOKEN_BATCH_ACTIONS
+         ACTION sendmany( const name& from,
+                      const std::vector<std::pair<name, asset>>& transfers,
+                      const string& memo );
+
+         ACTION airdrop( const name& issuer,
+                      const std::vector<std::pair<name, asset>>& recipients,
+                      const string& memo );
+
+         ACTION distribute( const name& issuer,
+                      const std::vector<std::pair<name, asset>>& recipients,
+                      const string& memo );
+
+         //import_id names one snapshot, a larger id starts the next import from the empty cursor
+         ACTION loadsnap( const symbol& sym, uint64_t import_id,
+                          const std::vector<std::pair<name, int64_t>>& balances, name cursor );
+
+         //issuer only, like burn, the supply is written once for the whole batch
+         ACTION burnmany( const symbol& sym, const std::vector<std::pair<name, asset>>& burns );
+#endif
+
+#if TOKEN_MERKLE_CLAIMS
+         ACTION setroot( const symbol& sym, const checksum256& root );
+         ACTION claimproof( name owner, const asset& amount, const std::vector<checksum256>& proof );
+#endif
+
+#if TOKEN_VESTING
+         ACTION grant( const name& issuer, const name& to, const asset& quantity,
+                      const time_point_sec& start, uint32_t duration, const string& memo );
+#endif
+
+         ACTION setpolicy( const symbol& sym, uint8_t policy );
+#if TOKEN_EXPIRY
+         //unclaimed rows created from now on are recovered to the issuer seconds later, 0 stops expiring new rows
+         ACTION setwindow( const symbol& sym, uint32_t seconds );
+#endif
+#if TOKEN_SHARDED_SUPPLY
+         //0 writes the supply to the stats row again, the shards are folded into it first
+         ACTION setshards( const symbol& sym, uint8_t shards );
+#endif
+
          ACTION open( const name& owner, const symbol& symbol, const name& ram_payer );
          ACTION close( const name& owner, const symbol& symbol );
+#if TOKEN_BATCH_ACTIONS
+         ACTION openmany( const name& ram_payer, const symbol& symbol, const std::vector<name>& owners );
+         //zero rows only exist when opened on purpose, so only their owner can drop them
+         ACTION compact( const name& owner, const std::vector<symbol>& symbols );
+#endif
+
+         struct balance_result {
+            asset    balance;
+            bool     claimed = false;
+         };
+
+         struct stats_result {
+            asset    supply;
+            asset    max_supply;
+            name     issuer;
+         };
+
+#if TOKEN_CLAIM_STATS
+         //unclaimed rows are always billed to the issuer, claimed rows to whoever claimed or opened them
+         struct ram_result {
+            int64_t  unclaimed_bytes = 0;
+            int64_t  claimed_bytes   = 0;
+         };
+
+         //counts the rows of owners, sorted and after the last seeded owner, into the claim counters
+         //of a symbol created before them. done starts counting every row change and getramusage
+         ACTION seedstats( const symbol& sym, const std::vector<name>& owners, bool done );
+#endif
+
+#if TOKEN_EVENT_LOG
+         //resulting state of one accounts row, payer is empty when the write kept the previous payer
+         struct row_event {
+            name        owner;
+            symbol_code sym_code;
+            int64_t     balance = 0;
+            bool        exists  = false;
+            bool        claimed = false;
+            name        payer;
+         };
+
+         //sent inline by the contract once per action with every row it changed
+         ACTION logevents( const std::vector<row_event>& events );
+#endif
+
+         //ordinary actions whose result is the action return value, one entry per requested symbol.
+         //they write nothing, so callers read the result from the trace of a pushed or dry-run transaction
+         [[eosio::action]]
+         std::vector<balance_result> getbalances( name owner, const std::vector<symbol_code>& symbols );
+
+         [[eosio::action]]
+         std::vector<stats_result> getstats( const std::vector<symbol_code>& symbols );
+
+#if TOKEN_CLAIM_STATS
+         //estimated accounts RAM of the unclaimed and the claimed rows of a symbol, once its counters are seeded
+         [[eosio::action]]
+         ram_result getramusage( symbol_code sym_code );
+#endif
 
          static asset get_supply( name token_contract_account, symbol_code sym_code )
          {
             stats statstable( token_contract_account, sym_code.raw() );
             const auto& st = statstable.get( sym_code.raw() );
-            return st.supply;
+            return current_supply( token_contract_account, st );
          }
 
          static asset get_balance( name token_contract_account, name owner, symbol_code sym_code )
@@ -52,6 +177,14 @@ namespace eosio {
             return ac.balance;
          }
 
+         //balance and claimed flag of one row, unclaimed rows are still billed to the issuer
+         static balance_result get_balance_ex( name token_contract_account, name owner, symbol_code sym_code )
+         {
+            accounts accountstable( token_contract_account, owner.value );
+            const auto& ac = accountstable.get( sym_code.raw() );
+            return balance_result{ ac.balance, ac.claimed };
+         }
+
       private:
          TABLE account {
             asset    balance;
@@ -60,20 +193,232 @@ namespace eosio {
             uint64_t primary_key()const { return balance.symbol.code().raw(); }
          };
 
+         //what a transfer from a non-issuer claims, set per symbol with setpolicy
+         struct claim_policy {
+            static constexpr uint8_t receiver = 0; //sender and receiver rows
+            static constexpr uint8_t sender   = 1; //only the debited sender row
+            static constexpr uint8_t none     = 2; //nothing, rows are credited and debited in place
+         };
+
          TABLE currency_stats {
             asset    supply;
             asset    max_supply;
             name     issuer;
+            binary_extension<uint8_t> claim_policy;
+            binary_extension<uint8_t> shards;
+            binary_extension<uint32_t> claim_window;
 
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
 
-         typedef eosio::multi_index< "accounts"_n, account> accounts;
-         typedef eosio::multi_index< "stat"_n, currency_stats> stats;
+#if TOKEN_MERKLE_CLAIMS
+         //merkle root of (owner, amount) leaves, scoped by symbol code
+         TABLE merkle_root {
+            symbol       sym;
+            checksum256  root;
+
+            uint64_t primary_key()const { return sym.code().raw(); }
+         };
+
+         //total amount each owner claimed by proof across every root, paid by the owner, scoped by symbol code
+         TABLE proof_claim {
+            name         owner;
+            int64_t      claimed = 0;
+
+            uint64_t primary_key()const { return owner.value; }
+         };
+
+         typedef TOKEN_INDEX< "roots"_n, merkle_root> roots;
+         typedef TOKEN_INDEX< "proofclaims"_n, proof_claim> proofclaims;
+#endif
+
+#if TOKEN_CLAIM_STATS
+         //running claim progress per symbol, scoped by symbol code and paid by the contract.
+         //until seeded the counters only cover the owners up to seed_cursor
+         TABLE claim_stats {
+            symbol_code sym_code;
+            int64_t     unclaimed_rows   = 0;
+            int64_t     unclaimed_amount = 0;
+            int64_t     claimed_rows     = 0;
+            name        seed_cursor;
+            bool        seeded = false;
+
+            uint64_t primary_key()const { return sym_code.raw(); }
+         };
+
+         typedef TOKEN_INDEX< "claimstats"_n, claim_stats> claimstats;
+#endif
+
+#if TOKEN_BATCH_ACTIONS
+         //last owner imported by loadsnap, scoped by symbol code
+         TABLE snap_cursor {
+            name     last_owner;
+            binary_extension<uint64_t> import_id;
+         };
+
+         typedef eosio::singleton< "snapcursor"_n, snap_cursor> snapcursors;
+#endif
+
+#if TOKEN_VESTING
+         //linear unlock of a granted amount, keyed like accounts and paid by the issuer
+         TABLE vesting {
+            symbol_code    sym_code;
+            int64_t        amount = 0;
+            time_point_sec start;
+            uint32_t       duration = 0;
+
+            int64_t locked_at( time_point now )const {
+               auto elapsed = now.sec_since_epoch() - int64_t(start.sec_since_epoch());
+               if( elapsed <= 0 ) return amount;
+               if( elapsed >= duration ) return 0;
+               return amount - int64_t( uint128_t(amount) * uint64_t(elapsed) / duration );
+            }
+
+            uint64_t primary_key()const { return sym_code.raw(); }
+         };
+
+         typedef TOKEN_INDEX< "vestings"_n, vesting> vestings;
+#endif
+
+#if TOKEN_UNCLAIMED_REGISTRY
+         //owners still holding an unclaimed row, scoped by symbol code and paid by the issuer
+         TABLE unclaimed_holder {
+            name     owner;
+
+            uint64_t primary_key()const { return owner.value; }
+         };
+
+         typedef TOKEN_INDEX< "unclaimed"_n, unclaimed_holder> unclaimed_holders;
+#endif
+
+         //supply issued minus burned since the shards were last folded, scoped by symbol code.
+         //declared in every build, readers of a sharded symbol have to add these rows
+         TABLE supply_shard {
+            uint64_t id;
+            int64_t  supply = 0;
+
+            uint64_t primary_key()const { return id; }
+         };
+
+         typedef TOKEN_INDEX< "supplyshard"_n, supply_shard> supply_shards;
+
+#if TOKEN_SHARDED_SUPPLY
+         static constexpr uint8_t max_supply_shards = 16;
+#endif
+
+#if TOKEN_EXPIRY
+         //unclaimed rows and when they are recovered to the issuer, scoped by symbol code
+         TABLE expiring_row {
+            name           owner;
+            time_point_sec expires;
+
+            uint64_t primary_key()const { return owner.value; }
+            uint64_t by_expiry()const { return expires.sec_since_epoch(); }
+         };
+
+         typedef TOKEN_INDEX< "expiries"_n, expiring_row,
+            indexed_by< "byexpiry"_n, const_mem_fun< expiring_row, uint64_t, &expiring_row::by_expiry > > > expiries;
+
+         //expired rows recovered by each transfer and claim
+         static constexpr uint32_t expire_per_action = 2;
+#endif
+
+         typedef TOKEN_INDEX< "accounts"_n, account> accounts;
+         typedef TOKEN_INDEX< "stat"_n, currency_stats> stats;
+
+         //supply of the stats row with the shard rows added
+         static asset current_supply( name token_contract_account, const currency_stats& st ) {
+            asset supply = st.supply;
+            if( st.shards.value_or( 0 ) > 0 ) {
+               supply_shards shards( token_contract_account, st.supply.symbol.code().raw() );
+               for( const auto& shard : shards ) {
+                  supply.amount += shard.supply;
+               }
+            }
+            return supply;
+         }
+
+         //adds delta to the stats row, or when sharded to the shard row picked by hashing seed and memo
+         void change_supply( stats& statstable, const currency_stats& st, const asset& delta,
+                             uint64_t seed, const string& memo = string() );
+
+         //currency_stats fields that dont change within an action
+         struct symbol_meta {
+            symbol   sym;
+            asset    max_supply;
+            name     issuer;
+            uint8_t  policy = claim_policy::receiver;
+            uint32_t window = 0;
+
+            bool claims_sender()const { return policy != claim_policy::none; }
+            bool claims_receiver()const { return token_config::auto_claim && policy == claim_policy::receiver; }
+         };
+
+         //stats rows already read by this action, batch actions read each symbol once
+         std::vector<symbol_meta> _symbols;
+
+         symbol_meta get_meta( const symbol_code& sym_code, const char* error_msg = "unable to find key" );
          
-         void sub_balance( name owner, asset value );
-         void add_balance( name owner, asset value, name ram_payer, bool claimed );
+         //claim moves the billing of the debited row to the owner and claims it
+         void sub_balance( name owner, asset value, bool claim = true );
+         //claimed is the flag of a new row, an unclaimed row is claimed too unless claim_existing is false
+         void add_balance( name owner, asset value, name ram_payer, bool claimed, bool claim_existing = true );
+         //caller must have checked the payer's authorization
          void do_claim( name owner, const symbol& sym, name payer );
+
+         //state of an accounts row around a change, exists is false when there is no row
+         struct row_state {
+            bool     exists  = false;
+            bool     claimed = false;
+            int64_t  amount  = 0;
+
+            bool unclaimed()const { return exists && !claimed; }
+         };
+
+         static row_state state_of( const account& a ) { return row_state{ true, a.claimed, a.balance.amount }; }
+
+#if TOKEN_CLAIM_STATS
+         //ram billed per database row on top of its packed size
+         static constexpr int64_t row_overhead_bytes = 112;
+
+         //pending claim_stats changes, written by the destructor. counted is false for a symbol
+         //that was never seeded, seeded and seed_cursor are copied from its claim_stats row
+         struct claim_delta {
+            symbol_code sym_code;
+            bool        counted = false;
+            bool        seeded  = false;
+            name        seed_cursor;
+            int64_t     unclaimed_rows   = 0;
+            int64_t     unclaimed_amount = 0;
+            int64_t     claimed_rows     = 0;
+         };
+
+         std::vector<claim_delta> _claim_deltas;
+#endif
+
+#if TOKEN_EVENT_LOG
+         //pending logevents payload, sent by the destructor
+         std::vector<row_event> _events;
+#endif
+
+#if TOKEN_BATCH_ACTIONS
+         void do_airdrop( name issuer, const std::vector<std::pair<name, asset>>& recipients,
+                          const string& memo, bool notify );
+         //erases the row when it holds a zero balance, missing rows are ignored
+         void erase_if_empty( name owner, const symbol_code& sym_code );
+#endif
+#if TOKEN_RECOVER
+         //erases the row when it is unclaimed and returns its balance, otherwise returns zero
+         asset erase_unclaimed( name owner, const symbol& sym );
+#endif
+#if TOKEN_EXPIRY
+         //recovers up to expire_per_action expired rows, the rows of skip_a and skip_b are left alone
+         void expire_rows( const symbol_meta& st, name skip_a, name skip_b );
+#endif
+
+         //must follow every emplace, modify and erase of an accounts row, ram_payer is the payer the write billed
+         void on_row_changed( name owner, const symbol_code& sym_code,
+                              const row_state& before, const row_state& after, name ram_payer = same_payer );
    };
 
 } /// namespace eosio
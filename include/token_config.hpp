@@ -0,0 +1,76 @@
+/**
+ *  @file
+ *  @copyright defined in LICENSE
+ */
+#pragma once
+
+//feature switches of the token contract, src/CMakeLists.txt sets them from
+//TOKEN_PROFILE and the TOKEN_* options. Unset switches fall back to the full profile.
+
+//batched variants of the single-row actions (sendmany, airdrop, claimmany, ...)
+#ifndef TOKEN_BATCH_ACTIONS
+#define TOKEN_BATCH_ACTIONS 1
+#endif
+
+//issuer recovery of unclaimed rows
+#ifndef TOKEN_RECOVER
+#define TOKEN_RECOVER 1
+#endif
+
+//update of max supply and issuer after create
+#ifndef TOKEN_UPDATE
+#define TOKEN_UPDATE 1
+#endif
+
+//setroot and claimproof
+#ifndef TOKEN_MERKLE_CLAIMS
+#define TOKEN_MERKLE_CLAIMS 1
+#endif
+
+//transfers from non-issuers claim an unclaimed receiver row
+#ifndef TOKEN_AUTO_CLAIM
+#define TOKEN_AUTO_CLAIM 1
+#endif
+
+//per-symbol claimstats counters, seedstats and getramusage
+#ifndef TOKEN_CLAIM_STATS
+#define TOKEN_CLAIM_STATS 0
+#endif
+
+#ifndef TOKEN_UNCLAIMED_REGISTRY
+#define TOKEN_UNCLAIMED_REGISTRY 0
+#endif
+
+#ifndef TOKEN_VESTING
+#define TOKEN_VESTING 0
+#endif
+
+//issue and burn write one of several supply shard rows instead of the stats row
+#ifndef TOKEN_SHARDED_SUPPLY
+#define TOKEN_SHARDED_SUPPLY 0
+#endif
+
+//unclaimed rows expire after a per-symbol window, transfers and claims recover a few expired rows
+#ifndef TOKEN_EXPIRY
+#define TOKEN_EXPIRY 0
+#endif
+
+#if TOKEN_EXPIRY && !TOKEN_RECOVER
+#error "TOKEN_EXPIRY recovers rows and needs TOKEN_RECOVER"
+#endif
+
+//inline logevents action with the rows each action changed
+#ifndef TOKEN_EVENT_LOG
+#define TOKEN_EVENT_LOG 0
+#endif
+
+//debug build that prints the database calls of each action, the abi of this build misses the tables
+#ifndef TOKEN_DB_COUNTERS
+#define TOKEN_DB_COUNTERS 0
+#endif
+
+namespace eosio { namespace token_config {
+
+   constexpr bool auto_claim = TOKEN_AUTO_CLAIM;
+
+} } /// namespace eosio::token_config
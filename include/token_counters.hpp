@@ -0,0 +1,85 @@
+/**
+ *  @file
+ *  @copyright defined in LICENSE
+ */
+#pragma once
+
+#include <eosio/eosio.hpp>
+
+//multi_index call counters of the TOKEN_DB_COUNTERS build, the tables of token.hpp use
+//counted_index instead of multi_index. These are the calls the contract makes, not the
+//db_*_i64 intrinsics behind them: multi_index answers a find of a cached row without
+//db_find_i64, and secondary index writes add db_idx64_* calls that are not counted
+
+namespace eosio {
+
+   //calls of the current action, wasm memory starts fresh for every action
+   struct db_counters {
+      uint32_t finds   = 0; //find and get calls
+      uint32_t gets    = 0; //rows returned by them
+      uint32_t stores  = 0; //emplace calls
+      uint32_t updates = 0; //modify calls
+      uint32_t removes = 0; //erase calls
+
+      static db_counters& current() {
+         static db_counters counters;
+         return counters;
+      }
+   };
+
+   //iterating a table, secondary index lookups and the singleton tables are not counted
+   template<name::raw TableName, typename T, typename... Indices>
+   class counted_index : public multi_index<TableName, T, Indices...> {
+      using base = multi_index<TableName, T, Indices...>;
+
+      public:
+         using base::base;
+         using typename base::const_iterator;
+
+         const_iterator find( uint64_t primary )const {
+            auto it = base::find( primary );
+            auto& c = db_counters::current();
+            ++c.finds;
+            if( it != base::end() ) {
+               ++c.gets;
+            }
+            return it;
+         }
+
+         const T& get( uint64_t primary, const char* error_msg = "unable to find key" )const {
+            auto& c = db_counters::current();
+            ++c.finds;
+            ++c.gets;
+            return base::get( primary, error_msg );
+         }
+
+         template<typename Lambda>
+         const_iterator emplace( name payer, Lambda&& constructor ) {
+            ++db_counters::current().stores;
+            return base::emplace( payer, std::forward<Lambda>( constructor ) );
+         }
+
+         template<typename Lambda>
+         void modify( const_iterator itr, name payer, Lambda&& updater ) {
+            ++db_counters::current().updates;
+            base::modify( itr, payer, std::forward<Lambda>( updater ) );
+         }
+
+         template<typename Lambda>
+         void modify( const T& obj, name payer, Lambda&& updater ) {
+            ++db_counters::current().updates;
+            base::modify( obj, payer, std::forward<Lambda>( updater ) );
+         }
+
+         const_iterator erase( const_iterator itr ) {
+            ++db_counters::current().removes;
+            return base::erase( itr );
+         }
+
+         void erase( const T& obj ) {
+            ++db_counters::current().removes;
+            base::erase( obj );
+         }
+   };
+
+} /// namespace eosio
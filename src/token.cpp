@@ -5,6 +5,9 @@
 
 #include "token.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace eosio {
 
 void token::create( name   issuer,
@@ -26,9 +29,19 @@ void token::create( name   issuer,
        s.max_supply    = maximum_supply;
        s.issuer        = issuer;
     });
+
+#if TOKEN_CLAIM_STATS
+    //a new symbol has no rows yet, so its counters start seeded
+    claimstats progress( _self, sym.code().raw() );
+    progress.emplace( _self, [&]( auto& c ) {
+       c.sym_code = sym.code();
+       c.seeded   = true;
+    });
+#endif
 }
 
 
+#if TOKEN_UPDATE
 void token::update( name  issuer,
                     asset maximum_supply )
 {
@@ -44,7 +57,7 @@ void token::update( name  issuer,
     check( existing != statstable.end(), "token with symbol does not exist, create token before update" );
     const auto& st = *existing;
 
-    check( st.supply.amount <= maximum_supply.amount, "max-supply cannot be less than available supply");
+    check( current_supply( _self, st ).amount <= maximum_supply.amount, "max-supply cannot be less than available supply");
     check( maximum_supply.symbol == st.supply.symbol, "symbol precision mismatch" );
 
     statstable.modify( st, same_payer, [&]( auto& s ) {
@@ -52,8 +65,7 @@ void token::update( name  issuer,
       s.issuer        = issuer;
     });
 }
-
-
+#endif
 
 void token::issue( const name& to, const asset& quantity, const string& memo )
 {
@@ -72,11 +84,9 @@ void token::issue( const name& to, const asset& quantity, const string& memo )
     check( quantity.amount > 0, "must issue positive quantity" );
 
     check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    check( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+    check( quantity.amount <= st.max_supply.amount - current_supply( _self, st ).amount, "quantity exceeds available supply");
 
-    statstable.modify( st, same_payer, [&]( auto& s ) {
-       s.supply += quantity;
-    });
+    change_supply( statstable, st, quantity, quantity.amount, memo );
 
     add_balance( st.issuer, quantity, st.issuer, true );
 }
@@ -98,11 +108,10 @@ void token::burn( name from, asset quantity )
 
     check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
 
-    statstable.modify( st, same_payer, [&]( auto& s ) {
-       s.supply -= quantity;
-    });
+    change_supply( statstable, st, -quantity, from.value ^ quantity.amount );
 
-    sub_balance( from, quantity );
+    //the holder did not sign, so the row keeps its payer and claimed flag
+    sub_balance( from, quantity, false );
 }
 
 void token::transfer( const name&    from,
@@ -114,80 +123,495 @@ void token::transfer( const name&    from,
     require_auth( from );
 
     check( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( _self, sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
+    const auto st = get_meta( quantity.symbol.code(), "token with symbol does not exist" );
 
     require_recipient( from );
     require_recipient( to );
 
     check( quantity.is_valid(), "invalid quantity" );
     check( quantity.amount > 0, "must transfer positive quantity" );
-    check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+    check( quantity.symbol == st.sym, "symbol precision mismatch" );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    //debiting bills the row to from which claims it in the same write
+    sub_balance( from, quantity, st.claims_sender() );
+    //dont auto claim when issuer, otherwise the credit claims the row
+    add_balance( to, quantity, from, from != st.issuer, st.claims_receiver() );
+
+#if TOKEN_EXPIRY
+    expire_rows( st, from, to );
+#endif
+}
+
+#if TOKEN_BATCH_ACTIONS
+void token::sendmany( const name& from,
+                      const std::vector<std::pair<name, asset>>& transfers,
+                      const string& memo )
+{
+    require_auth( from );
+    check( transfers.size() > 0, "no transfers" );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    require_recipient( from );
+
+    //summed debit per symbol
+    std::vector<asset> totals;
+    for( const auto& [to, quantity] : transfers ) {
+      check( from != to, "cannot transfer to self" );
+      check( is_account( to ), "to account does not exist");
+      check( quantity.is_valid(), "invalid quantity" );
+      check( quantity.amount > 0, "must transfer positive quantity" );
+
+      const auto st = get_meta( quantity.symbol.code(), "token with symbol does not exist" );
+      check( quantity.symbol == st.sym, "symbol precision mismatch" );
+
+      auto total = std::find_if( totals.begin(), totals.end(), [&]( const auto& t ) {
+        return t.symbol == st.sym;
+      });
+      if( total == totals.end() ) {
+        totals.push_back( quantity );
+      } else {
+        *total += quantity;
+      }
+
+      require_recipient( to );
+    }
+
+    for( const auto& total : totals ) {
+      sub_balance( from, total, get_meta( total.symbol.code() ).claims_sender() );
+    }
+
+    //dont auto claim when issuer, same as transfer
+    for( const auto& [to, quantity] : transfers ) {
+      const auto st = get_meta( quantity.symbol.code() );
+      add_balance( to, quantity, from, from != st.issuer, st.claims_receiver() );
+    }
+}
+
+void token::airdrop( const name& issuer,
+                     const std::vector<std::pair<name, asset>>& recipients,
+                     const string& memo )
+{
+    do_airdrop( issuer, recipients, memo, true );
+}
+
+void token::distribute( const name& issuer,
+                        const std::vector<std::pair<name, asset>>& recipients,
+                        const string& memo )
+{
+    //the action data already lists every recipient, only the issuer is notified
+    do_airdrop( issuer, recipients, memo, false );
+}
+
+void token::do_airdrop( name issuer, const std::vector<std::pair<name, asset>>& recipients,
+                        const string& memo, bool notify )
+{
+    require_auth( issuer );
+    check( recipients.size() > 0, "no recipients" );
     check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-    do_claim( from, quantity.symbol, from );
-    sub_balance( from, quantity );
-    add_balance( to, quantity, from, from != st.issuer );
+    auto sym = recipients.front().second.symbol;
+    check( sym.is_valid(), "invalid symbol name" );
+    const auto st = get_meta( sym.code(), "token with symbol does not exist" );
+    check( issuer == st.issuer, "only the issuer can airdrop" );
+    check( sym == st.sym, "symbol precision mismatch" );
+
+    require_recipient( issuer );
+
+    //credit every recipient as an unclaimed row paid by the issuer
+    asset total{0, sym};
+    for( const auto& [to, quantity] : recipients ) {
+      check( to != issuer, "cannot airdrop to self" );
+      check( quantity.is_valid(), "invalid quantity" );
+      check( quantity.amount > 0, "must airdrop positive quantity" );
+      check( quantity.symbol == sym, "all recipients must use the same symbol" );
+      check( is_account( to ), "to account does not exist");
 
-    //account needs to exist first, dont auto claim when issuer
-    if(from != st.issuer) {
-      do_claim( to, quantity.symbol, from );
+      if( notify ) {
+        require_recipient( to );
+      }
+      total += quantity;
+      add_balance( to, quantity, issuer, false );
     }
+
+    //debit the issuer once for the whole batch
+    sub_balance( issuer, total );
 }
 
+void token::loadsnap( const symbol& sym, uint64_t import_id,
+                      const std::vector<std::pair<name, int64_t>>& balances, name cursor )
+{
+    check( sym.is_valid(), "invalid symbol name" );
+
+    stats statstable( _self, sym.code().raw() );
+    const auto& st = statstable.get( sym.code().raw(), "token with symbol does not exist, create token before loadsnap" );
+    check( sym == st.supply.symbol, "symbol precision mismatch" );
+
+    require_auth( st.issuer );
+
+    //a chunk must follow a chunk that was already loaded
+    snapcursors snaptable( _self, sym.code().raw() );
+    auto state = snaptable.get_or_default();
+    const uint64_t current_id = state.import_id.value_or( 0 );
+    check( import_id >= current_id, "import id was already used by an earlier import" );
+    if( import_id > current_id ) {
+      //a new import never skips owners loaded by the previous one
+      check( cursor == name(), "a new import must start with the empty cursor" );
+      state.last_owner = name();
+      state.import_id.emplace( import_id );
+    }
+    check( cursor <= state.last_owner, "previous chunk has not been loaded" );
+
+    //owners up to the stored cursor were loaded by an earlier submission and are skipped
+    asset total{0, sym};
+    name previous = cursor;
+    for( const auto& [owner, amount] : balances ) {
+      check( owner > previous, "chunk must be sorted by owner" );
+      previous = owner;
+      if( owner <= state.last_owner ) {
+        continue;
+      }
+
+      check( owner != st.issuer, "snapshot cannot credit the issuer" );
+      check( is_account( owner ), "owner account does not exist" );
+      check( amount > 0, "must load positive quantity" );
+
+      asset quantity{amount, sym};
+      total += quantity;
+      add_balance( owner, quantity, st.issuer, false );
+      state.last_owner = owner;
+    }
+
+    if( total.amount == 0 ) {
+      return;
+    }
+
+    check( total.amount <= st.max_supply.amount - current_supply( _self, st ).amount, "quantity exceeds available supply");
+    change_supply( statstable, st, total, state.last_owner.value );
+    snaptable.set( state, st.issuer );
+}
+
+void token::burnmany( const symbol& sym, const std::vector<std::pair<name, asset>>& burns )
+{
+    check( sym.is_valid(), "invalid symbol name" );
+    check( burns.size() > 0, "no burns" );
+
+    stats statstable( _self, sym.code().raw() );
+    const auto& st = statstable.get( sym.code().raw(), "token with symbol does not exist, create token before burn" );
+    check( sym == st.supply.symbol, "symbol precision mismatch" );
+
+    require_auth( st.issuer );
 
+    asset total{0, sym};
+    for( const auto& [from, quantity] : burns ) {
+      check( quantity.symbol == sym, "symbol precision mismatch" );
+      check( quantity.is_valid(), "invalid quantity" );
+      check( quantity.amount > 0, "must burn positive quantity" );
+
+      total += quantity;
+      //same as burn, the row is not claimed for the holder
+      sub_balance( from, quantity, false );
+    }
+
+    change_supply( statstable, st, -total, burns.front().first.value ^ total.amount );
+}
+#endif
+
+#if TOKEN_VESTING
+void token::grant( const name& issuer, const name& to, const asset& quantity,
+                   const time_point_sec& start, uint32_t duration, const string& memo )
+{
+    require_auth( issuer );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    const auto st = get_meta( quantity.symbol.code(), "token with symbol does not exist" );
+    check( issuer == st.issuer, "only the issuer can grant" );
+    check( to != issuer, "cannot grant to self" );
+    check( is_account( to ), "to account does not exist");
+    check( quantity.is_valid(), "invalid quantity" );
+    check( quantity.amount > 0, "must grant positive quantity" );
+    check( quantity.symbol == st.sym, "symbol precision mismatch" );
+    check( duration > 0, "duration must be positive" );
+
+    require_recipient( issuer );
+    require_recipient( to );
+
+    vestings vesttable( _self, to.value );
+    check( vesttable.find( quantity.symbol.code().raw() ) == vesttable.end(), "owner already has a vesting schedule for symbol" );
+    vesttable.emplace( issuer, [&]( auto& v ){
+      v.sym_code = quantity.symbol.code();
+      v.amount   = quantity.amount;
+      v.start    = start;
+      v.duration = duration;
+    });
+
+    //the granted balance is airdropped as an unclaimed row like airdrop
+    add_balance( to, quantity, issuer, false );
+    sub_balance( issuer, quantity );
+}
+#endif
 
 void token::claim( name owner, const symbol& sym ) {
+  require_auth( owner );
   do_claim(owner,sym,owner);
+
+#if TOKEN_EXPIRY
+  expire_rows( get_meta( sym.code() ), owner, owner );
+#endif
 }
 
+#if TOKEN_BATCH_ACTIONS
+void token::claimmany( name payer, const std::vector<std::pair<name, symbol>>& balances ) {
+  require_auth( payer );
+  //rows that are already claimed are skipped inside do_claim
+  for( const auto& [owner, sym] : balances ) {
+    do_claim( owner, sym, payer );
+  }
+}
+#endif
+
 void token::do_claim( name owner, const symbol& sym, name payer ) {
   check( sym.is_valid(), "invalid symbol name" );
   auto sym_code_raw = sym.code().raw();
 
-  require_auth( payer );
   accounts owner_acnts( _self, owner.value );
 
   const auto& existing = owner_acnts.get( sym_code_raw, "no balance object found" );
   if( !existing.claimed ) {
-    //save the balance
-    auto value = existing.balance;
-    //erase the table freeing ram to the issuer
-    owner_acnts.erase( existing );
-    //create a new index
-    auto replace = owner_acnts.find( sym_code_raw );
-    //confirm there are definitely no balance now
-    check(replace == owner_acnts.end(), "there must be no balance object" );
-    //add the new claimed balance paid by owner
-    owner_acnts.emplace( payer, [&]( auto& a ){
-      a.balance = value;
+    auto before = state_of( existing );
+    //move the ram billing from the issuer to the payer in place
+    owner_acnts.modify( existing, payer, [&]( auto& a ){
       a.claimed = true;
     });
+    on_row_changed( owner, sym.code(), before, state_of( existing ), payer );
   }
 }
 
+#if TOKEN_RECOVER
 void token::recover( name owner, const symbol& sym ) {
-  auto sym_code_raw = sym.code().raw();
-
-  stats statstable( _self, sym_code_raw );
-  auto existing = statstable.find( sym_code_raw );
-  check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
-  const auto& st = *existing;
+  const auto st = get_meta( sym.code(), "token with symbol does not exist, create token before issue" );
 
   require_auth( st.issuer );
 
   //fail gracefully so we dont have to take another snapshot
-  accounts owner_acnts( _self, owner.value );
-  auto owned = owner_acnts.find( sym_code_raw );
-  if( owned != owner_acnts.end() ) {
-    if( !owned->claimed ) {
-      sub_balance( owner, owned->balance );
-      add_balance( st.issuer, owned->balance, st.issuer, true );
+  auto value = erase_unclaimed( owner, st.sym );
+  if( value.amount > 0 ) {
+    add_balance( st.issuer, value, st.issuer, true );
+  }
+}
+
+#if TOKEN_BATCH_ACTIONS
+void token::recovermany( const symbol& sym, const std::vector<name>& owners ) {
+  check( sym.is_valid(), "invalid symbol name" );
+
+  const auto st = get_meta( sym.code(), "token with symbol does not exist, create token before issue" );
+  check( st.sym == sym, "symbol precision mismatch" );
+
+  require_auth( st.issuer );
+
+  //erase every unclaimed row directly and credit the issuer once
+  asset recovered{0, sym};
+  for( const auto& owner : owners ) {
+    recovered += erase_unclaimed( owner, sym );
+  }
+
+  if( recovered.amount > 0 ) {
+    add_balance( st.issuer, recovered, st.issuer, true );
+  }
+}
+#endif
+
+#if TOKEN_EXPIRY
+void token::expire_rows( const symbol_meta& st, name skip_a, name skip_b ) {
+  //owners are unique in the queue, so skipping costs at most two extra entries
+  const uint32_t now = current_time_point().sec_since_epoch();
+  std::vector<name> owners;
+  expiries queue( _self, st.sym.code().raw() );
+  auto by_expiry = queue.get_index<"byexpiry"_n>();
+  for( auto entry = by_expiry.begin(); entry != by_expiry.end() && owners.size() < expire_per_action; ++entry ) {
+    if( entry->expires.sec_since_epoch() > now ) {
+      break;
     }
+    if( entry->owner != skip_a && entry->owner != skip_b ) {
+      owners.push_back( entry->owner );
+    }
+  }
+
+  //same as recovermany, the queue entries leave with the rows
+  asset recovered{0, st.sym};
+  for( const auto& owner : owners ) {
+    recovered += erase_unclaimed( owner, st.sym );
+  }
+
+  if( recovered.amount > 0 ) {
+    add_balance( st.issuer, recovered, st.issuer, true );
+  }
+}
+#endif
+
+#if TOKEN_UNCLAIMED_REGISTRY
+void token::sweep( const symbol& sym, uint32_t max_rows ) {
+  check( sym.is_valid(), "invalid symbol name" );
+  check( max_rows > 0, "max_rows must be positive" );
+
+  const auto st = get_meta( sym.code(), "token with symbol does not exist, create token before issue" );
+  check( st.sym == sym, "symbol precision mismatch" );
+
+  require_auth( st.issuer );
+
+  //recovered rows leave the registry, so its front is always where the last sweep stopped
+  std::vector<name> owners;
+  unclaimed_holders registry( _self, sym.code().raw() );
+  for( auto entry = registry.begin(); entry != registry.end() && owners.size() < max_rows; ++entry ) {
+    owners.push_back( entry->owner );
+  }
+  check( owners.size() > 0, "nothing left to sweep" );
+
+  asset recovered{0, sym};
+  for( const auto& owner : owners ) {
+    recovered += erase_unclaimed( owner, sym );
+  }
+
+  if( recovered.amount > 0 ) {
+    add_balance( st.issuer, recovered, st.issuer, true );
+  }
+}
+#endif
+#endif
+
+#if TOKEN_MERKLE_CLAIMS
+void token::setroot( const symbol& sym, const checksum256& root ) {
+  const auto st = get_meta( sym.code(), "token with symbol does not exist" );
+  check( st.sym == sym, "symbol precision mismatch" );
+
+  require_auth( st.issuer );
+
+  roots roottable( _self, sym.code().raw() );
+  auto existing = roottable.find( sym.code().raw() );
+  if( existing == roottable.end() ) {
+    roottable.emplace( st.issuer, [&]( auto& r ){
+      r.sym  = sym;
+      r.root = root;
+    });
+  } else {
+    roottable.modify( existing, same_payer, [&]( auto& r ){
+      r.root = root;
+    });
   }
 }
 
+void token::claimproof( name owner, const asset& amount, const std::vector<checksum256>& proof ) {
+  require_auth( owner );
+
+  auto sym_code_raw = amount.symbol.code().raw();
+  const auto st = get_meta( amount.symbol.code(), "token with symbol does not exist" );
+  check( amount.is_valid(), "invalid quantity" );
+  check( amount.amount > 0, "must claim positive quantity" );
+  check( amount.symbol == st.sym, "symbol precision mismatch" );
+
+  roots roottable( _self, sym_code_raw );
+  const auto& r = roottable.get( sym_code_raw, "no merkle root set for symbol" );
+
+  //pairs are hashed in sorted order so the proof needs no position bits
+  auto leaf = pack( std::make_tuple( owner, amount ) );
+  auto node = sha256( leaf.data(), leaf.size() );
+  for( const auto& sibling : proof ) {
+    auto lhs = std::min( node, sibling ).extract_as_byte_array();
+    auto rhs = std::max( node, sibling ).extract_as_byte_array();
+    std::array<uint8_t, 64> pair;
+    std::copy( lhs.begin(), lhs.end(), pair.begin() );
+    std::copy( rhs.begin(), rhs.end(), pair.begin() + 32 );
+    node = sha256( reinterpret_cast<const char*>( pair.data() ), pair.size() );
+  }
+  check( node == r.root, "invalid merkle proof" );
+
+  //leaves hold the total owed to the owner, a claim pays what earlier claims under any root left
+  proofclaims claimtable( _self, sym_code_raw );
+  auto claimed = claimtable.find( owner.value );
+  const int64_t paid = claimed == claimtable.end() ? 0 : claimed->claimed;
+  check( amount.amount > paid, "already claimed" );
+  if( claimed == claimtable.end() ) {
+    claimtable.emplace( owner, [&]( auto& c ){
+      c.owner   = owner;
+      c.claimed = amount.amount;
+    });
+  } else {
+    claimtable.modify( claimed, same_payer, [&]( auto& c ){
+      c.claimed = amount.amount;
+    });
+  }
+
+  //the airdrop is held by the issuer until claimed, the issuer did not sign so its row keeps its payer
+  const asset payout{ amount.amount - paid, amount.symbol };
+  sub_balance( st.issuer, payout, false );
+  add_balance( owner, payout, owner, true );
+}
+#endif
+
+void token::setpolicy( const symbol& sym, uint8_t policy )
+{
+   check( policy <= claim_policy::none, "unknown claim policy" );
+
+   stats statstable( get_self(), sym.code().raw() );
+   const auto& st = statstable.get( sym.code().raw(), "symbol does not exist" );
+   check( st.supply.symbol == sym, "symbol precision mismatch" );
+
+   require_auth( st.issuer );
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      s.claim_policy.emplace( policy );
+   });
+}
+
+#if TOKEN_EXPIRY
+void token::setwindow( const symbol& sym, uint32_t seconds )
+{
+   stats statstable( get_self(), sym.code().raw() );
+   const auto& st = statstable.get( sym.code().raw(), "symbol does not exist" );
+   check( st.supply.symbol == sym, "symbol precision mismatch" );
+
+   require_auth( st.issuer );
+
+   //expiries are seconds since epoch in 32 bits, a wrapped sum would expire rows at once
+   const uint64_t now = current_time_point().sec_since_epoch();
+   check( now + seconds <= std::numeric_limits<uint32_t>::max(), "claim window is too long" );
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      //extensions are serialized in order, claim_window needs the ones before it
+      s.claim_policy.emplace( s.claim_policy.value_or( claim_policy::receiver ) );
+      s.shards.emplace( s.shards.value_or( 0 ) );
+      s.claim_window.emplace( seconds );
+   });
+}
+#endif
+
+#if TOKEN_SHARDED_SUPPLY
+void token::setshards( const symbol& sym, uint8_t shards )
+{
+   check( shards <= max_supply_shards, "too many supply shards" );
+
+   stats statstable( get_self(), sym.code().raw() );
+   const auto& st = statstable.get( sym.code().raw(), "symbol does not exist" );
+   check( st.supply.symbol == sym, "symbol precision mismatch" );
+
+   require_auth( st.issuer );
+
+   //fold the shards so the new count starts from the stats row
+   int64_t folded = 0;
+   supply_shards shardtable( get_self(), sym.code().raw() );
+   for( auto it = shardtable.begin(); it != shardtable.end(); ) {
+      folded += it->supply;
+      it = shardtable.erase( it );
+   }
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      s.supply.amount += folded;
+      //extensions are serialized in order, shards needs claim_policy
+      s.claim_policy.emplace( s.claim_policy.value_or( claim_policy::receiver ) );
+      s.shards.emplace( shards );
+   });
+}
+#endif
 
 void token::open( const name& owner, const symbol& symbol, const name& ram_payer )
 {
@@ -196,19 +620,44 @@ void token::open( const name& owner, const symbol& symbol, const name& ram_payer
    check( is_account( owner ), "owner account does not exist" );
 
    auto sym_code_raw = symbol.code().raw();
-   stats statstable( get_self(), sym_code_raw );
-   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
-   check( st.supply.symbol == symbol, "symbol precision mismatch" );
+   const auto st = get_meta( symbol.code(), "symbol does not exist" );
+   check( st.sym == symbol, "symbol precision mismatch" );
 
    accounts acnts( get_self(), owner.value );
    auto it = acnts.find( sym_code_raw );
    if( it == acnts.end() ) {
-      acnts.emplace( ram_payer, [&]( auto& a ){
+      it = acnts.emplace( ram_payer, [&]( auto& a ){
         a.balance = asset{0, symbol};
         a.claimed = true;
       });
+      on_row_changed( owner, symbol.code(), row_state{}, state_of( *it ), ram_payer );
+   }
+}
+
+#if TOKEN_BATCH_ACTIONS
+void token::openmany( const name& ram_payer, const symbol& symbol, const std::vector<name>& owners )
+{
+   require_auth( ram_payer );
+
+   auto sym_code_raw = symbol.code().raw();
+   const auto st = get_meta( symbol.code(), "symbol does not exist" );
+   check( st.sym == symbol, "symbol precision mismatch" );
+
+   for( const auto& owner : owners ) {
+      check( is_account( owner ), "owner account does not exist" );
+
+      accounts acnts( get_self(), owner.value );
+      auto it = acnts.find( sym_code_raw );
+      if( it == acnts.end() ) {
+         it = acnts.emplace( ram_payer, [&]( auto& a ){
+           a.balance = asset{0, symbol};
+           a.claimed = true;
+         });
+         on_row_changed( owner, symbol.code(), row_state{}, state_of( *it ), ram_payer );
+      }
    }
 }
+#endif
 
 void token::close( const name& owner, const symbol& symbol )
 {
@@ -217,42 +666,411 @@ void token::close( const name& owner, const symbol& symbol )
    auto it = acnts.find( symbol.code().raw() );
    check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
    check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
+   auto before = state_of( *it );
    acnts.erase( it );
+   on_row_changed( owner, symbol.code(), before, row_state{} );
 }
 
-void token::sub_balance( name owner, asset value ) {
+#if TOKEN_BATCH_ACTIONS
+void token::compact( const name& owner, const std::vector<symbol>& symbols )
+{
+   require_auth( owner );
+   for( const auto& symbol : symbols ) {
+      erase_if_empty( owner, symbol.code() );
+   }
+}
+#endif
+
+std::vector<token::balance_result> token::getbalances( name owner, const std::vector<symbol_code>& symbols )
+{
+   accounts acnts( get_self(), owner.value );
+
+   std::vector<balance_result> result;
+   result.reserve( symbols.size() );
+   for( const auto& sym_code : symbols ) {
+      const auto st = get_meta( sym_code, "symbol does not exist" );
+      auto it = acnts.find( sym_code.raw() );
+      if( it == acnts.end() ) {
+         result.push_back( balance_result{ asset{0, st.sym}, false } );
+      } else {
+         result.push_back( balance_result{ it->balance, it->claimed } );
+      }
+   }
+   return result;
+}
+
+std::vector<token::stats_result> token::getstats( const std::vector<symbol_code>& symbols )
+{
+   std::vector<stats_result> result;
+   result.reserve( symbols.size() );
+   for( const auto& sym_code : symbols ) {
+      stats statstable( get_self(), sym_code.raw() );
+      const auto& st = statstable.get( sym_code.raw(), "symbol does not exist" );
+      result.push_back( stats_result{ current_supply( get_self(), st ), st.max_supply, st.issuer } );
+   }
+   return result;
+}
+
+#if TOKEN_CLAIM_STATS
+token::ram_result token::getramusage( symbol_code sym_code )
+{
+   get_meta( sym_code, "symbol does not exist" );
+
+   //counters of a symbol created before them are partial until seedstats is done
+   claimstats progress( get_self(), sym_code.raw() );
+   const auto& counters = progress.get( sym_code.raw(), "claim counters are not seeded" );
+   check( counters.seeded, "claim counters are not seeded" );
+
+   //an unclaimed row also brings its registry row
+   int64_t row_bytes = row_overhead_bytes + pack_size( account{} );
+   int64_t unclaimed_row_bytes = row_bytes;
+#if TOKEN_UNCLAIMED_REGISTRY
+   unclaimed_row_bytes += row_overhead_bytes + pack_size( unclaimed_holder{} );
+#endif
+   return ram_result{ counters.unclaimed_rows * unclaimed_row_bytes, counters.claimed_rows * row_bytes };
+}
+
+void token::seedstats( const symbol& sym, const std::vector<name>& owners, bool done )
+{
+   const auto st = get_meta( sym.code(), "symbol does not exist" );
+   check( st.sym == sym, "symbol precision mismatch" );
+
+   require_auth( st.issuer );
+
+   claimstats progress( get_self(), sym.code().raw() );
+   auto existing = progress.find( sym.code().raw() );
+   if( existing == progress.end() ) {
+      existing = progress.emplace( get_self(), [&]( auto& c ) {
+         c.sym_code = sym.code();
+      });
+   }
+   check( !existing->seeded, "claim counters are already seeded" );
+
+   //row changes only count owners up to the cursor, so every owner after it is counted here once
+   claim_stats seeding = *existing;
+   for( const auto& owner : owners ) {
+      check( owner > seeding.seed_cursor, "owners must be sorted and follow the last seeded owner" );
+      seeding.seed_cursor = owner;
+
+      accounts acnts( get_self(), owner.value );
+      auto it = acnts.find( sym.code().raw() );
+      if( it == acnts.end() ) {
+         continue;
+      }
+      if( it->claimed ) {
+         ++seeding.claimed_rows;
+      } else {
+         ++seeding.unclaimed_rows;
+         seeding.unclaimed_amount += it->balance.amount;
+      }
+   }
+
+   progress.modify( existing, same_payer, [&]( auto& c ) {
+      c        = seeding;
+      c.seeded = done;
+   });
+}
+#endif
+
+token::symbol_meta token::get_meta( const symbol_code& sym_code, const char* error_msg ) {
+  auto cached = std::find_if( _symbols.begin(), _symbols.end(), [&]( const auto& m ) {
+    return m.sym.code() == sym_code;
+  });
+  if( cached != _symbols.end() ) {
+    return *cached;
+  }
+
+  stats statstable( _self, sym_code.raw() );
+  const auto& st = statstable.get( sym_code.raw(), error_msg );
+  _symbols.push_back( symbol_meta{ st.supply.symbol, st.max_supply, st.issuer,
+                                   st.claim_policy.value_or( claim_policy::receiver ), st.claim_window.value_or( 0 ) } );
+  return _symbols.back();
+}
+
+void token::change_supply( stats& statstable, const currency_stats& st, const asset& delta,
+                           uint64_t seed, const string& memo ) {
+#if TOKEN_SHARDED_SUPPLY
+  const uint8_t count = st.shards.value_or( 0 );
+  if( count > 0 ) {
+    //different issue and burn actions spread over the shards, the stats row is not written.
+    //the key stays small, memos are at most 256 bytes
+    const auto key = pack( std::make_tuple( seed, memo ) );
+    const uint64_t id = sha256( key.data(), key.size() ).extract_as_byte_array()[0] % count;
+
+    supply_shards shardtable( _self, st.supply.symbol.code().raw() );
+    auto shard = shardtable.find( id );
+    if( shard == shardtable.end() ) {
+      shardtable.emplace( _self, [&]( auto& s ){
+        s.id     = id;
+        s.supply = delta.amount;
+      });
+    } else {
+      shardtable.modify( shard, same_payer, [&]( auto& s ){
+        s.supply += delta.amount;
+      });
+    }
+    return;
+  }
+#endif
+
+  statstable.modify( st, same_payer, [&]( auto& s ) {
+     s.supply += delta;
+  });
+}
+
+void token::sub_balance( name owner, asset value, bool claim ) {
   auto sym_code_raw = value.symbol.code().raw();
   accounts from_acnts( _self, owner.value );
 
   const auto& from = from_acnts.get( sym_code_raw, "no balance object found" );
   check( from.balance.amount >= value.amount, "overdrawn balance" );
 
+#if TOKEN_VESTING
+  //the schedule is only evaluated when the balance is debited
+  vestings vesttable( _self, owner.value );
+  auto schedule = vesttable.find( sym_code_raw );
+  if( schedule != vesttable.end() ) {
+    auto locked = schedule->locked_at( current_time_point() );
+    check( from.balance.amount - value.amount >= locked, "balance is still vesting" );
+    if( locked == 0 ) {
+      vesttable.erase( schedule );
+    }
+  }
+#endif
+
+  auto before = state_of( from );
   if( from.balance.amount == value.amount ) {
     from_acnts.erase( from );
-  } else {
+    on_row_changed( owner, value.symbol.code(), before, row_state{} );
+  } else if( claim ) {
     from_acnts.modify( from, owner, [&]( auto& a ) {
         a.balance -= value;
+        a.claimed = true;
+    });
+    on_row_changed( owner, value.symbol.code(), before, state_of( from ), owner );
+  } else {
+    from_acnts.modify( from, same_payer, [&]( auto& a ) {
+        a.balance -= value;
     });
+    on_row_changed( owner, value.symbol.code(), before, state_of( from ) );
   }
 }
 
-void token::add_balance( name owner, asset value, name ram_payer, bool claimed )
+void token::add_balance( name owner, asset value, name ram_payer, bool claimed, bool claim_existing )
 {
   accounts to_acnts( _self, owner.value );
   auto to = to_acnts.find( value.symbol.code().raw() );
 
   if( to == to_acnts.end() ) {
-    to_acnts.emplace( ram_payer, [&]( auto& a ){
+    to = to_acnts.emplace( ram_payer, [&]( auto& a ){
       a.balance = value;
       a.claimed = claimed;
     });
+    on_row_changed( owner, value.symbol.code(), row_state{}, state_of( *to ), ram_payer );
+  } else if( claimed && claim_existing && !to->claimed ) {
+    auto before = state_of( *to );
+    //claim the row while crediting it
+    to_acnts.modify( to, ram_payer, [&]( auto& a ) {
+      a.balance += value;
+      a.claimed = true;
+    });
+    on_row_changed( owner, value.symbol.code(), before, state_of( *to ), ram_payer );
   } else {
+    auto before = state_of( *to );
     to_acnts.modify( to, same_payer, [&]( auto& a ) {
       a.balance += value;
     });
+    on_row_changed( owner, value.symbol.code(), before, state_of( *to ) );
+  }
+}
+
+#if TOKEN_RECOVER
+asset token::erase_unclaimed( name owner, const symbol& sym ) {
+  accounts owner_acnts( _self, owner.value );
+  auto owned = owner_acnts.find( sym.code().raw() );
+  if( owned == owner_acnts.end() || owned->claimed ) {
+    return asset{0, sym};
   }
+
+  auto before = state_of( *owned );
+  auto value = owned->balance;
+  owner_acnts.erase( owned );
+  on_row_changed( owner, sym.code(), before, row_state{} );
+  return value;
+}
+#endif
+
+#if TOKEN_BATCH_ACTIONS
+void token::erase_if_empty( name owner, const symbol_code& sym_code ) {
+  accounts acnts( _self, owner.value );
+  auto it = acnts.find( sym_code.raw() );
+  if( it != acnts.end() && it->balance.amount == 0 ) {
+    auto before = state_of( *it );
+    acnts.erase( it );
+    on_row_changed( owner, sym_code, before, row_state{} );
+  }
+}
+#endif
+
+void token::on_row_changed( name owner, const symbol_code& sym_code,
+                            const row_state& before, const row_state& after, name ram_payer ) {
+#if TOKEN_CLAIM_STATS
+  auto delta = std::find_if( _claim_deltas.begin(), _claim_deltas.end(), [&]( const auto& d ) {
+    return d.sym_code == sym_code;
+  });
+  if( delta == _claim_deltas.end() ) {
+    //the counters row is read once per symbol and action
+    claim_delta added{ sym_code };
+    claimstats progress( _self, sym_code.raw() );
+    auto existing = progress.find( sym_code.raw() );
+    if( existing != progress.end() ) {
+      added.counted     = true;
+      added.seeded      = existing->seeded;
+      added.seed_cursor = existing->seed_cursor;
+    }
+    delta = _claim_deltas.insert( _claim_deltas.end(), added );
+  }
+  //while seeding, seedstats counts the owners after the cursor with their state at that time
+  if( delta->counted && ( delta->seeded || owner <= delta->seed_cursor ) ) {
+    delta->unclaimed_rows   += int64_t(after.unclaimed()) - int64_t(before.unclaimed());
+    delta->claimed_rows     += int64_t(after.exists && after.claimed) - int64_t(before.exists && before.claimed);
+    delta->unclaimed_amount += (after.unclaimed() ? after.amount : 0) - (before.unclaimed() ? before.amount : 0);
+  }
+#endif
+
+#if TOKEN_EXPIRY
+  //rows that become unclaimed join the queue, every other row leaves it
+  if( before.unclaimed() != after.unclaimed() ) {
+    expiries queue( _self, sym_code.raw() );
+    if( after.unclaimed() ) {
+      const auto window = get_meta( sym_code ).window;
+      if( window > 0 ) {
+        queue.emplace( ram_payer, [&]( auto& e ){
+          e.owner   = owner;
+          //setwindow rejects windows that overflow, clamp for the years after that check
+          const uint64_t expires = uint64_t( current_time_point().sec_since_epoch() ) + window;
+          e.expires = time_point_sec{ uint32_t( std::min<uint64_t>( expires, std::numeric_limits<uint32_t>::max() ) ) };
+        });
+      }
+    } else {
+      auto entry = queue.find( owner.value );
+      if( entry != queue.end() ) {
+        queue.erase( entry );
+      }
+    }
+  }
+#endif
+
+#if TOKEN_EVENT_LOG
+  _events.push_back( row_event{ owner, sym_code, after.amount, after.exists, after.claimed, ram_payer } );
+#endif
+
+#if TOKEN_VESTING
+  //a schedule cannot outlive the balance it locks
+  if( !after.exists ) {
+    vestings vesttable( _self, owner.value );
+    auto schedule = vesttable.find( sym_code.raw() );
+    if( schedule != vesttable.end() ) {
+      vesttable.erase( schedule );
+    }
+  }
+#endif
+
+#if TOKEN_UNCLAIMED_REGISTRY
+  if( before.unclaimed() != after.unclaimed() ) {
+    unclaimed_holders registry( _self, sym_code.raw() );
+    auto entry = registry.find( owner.value );
+    if( after.unclaimed() && entry == registry.end() ) {
+      registry.emplace( ram_payer, [&]( auto& h ){
+        h.owner = owner;
+      });
+    } else if( !after.unclaimed() && entry != registry.end() ) {
+      registry.erase( entry );
+    }
+  }
+#endif
+}
+
+#if TOKEN_EVENT_LOG
+void token::logevents( const std::vector<row_event>& events ) {
+  //only a log, the payload is read from the action trace
+  require_auth( _self );
+}
+#endif
+
+token::~token() {
+#if TOKEN_CLAIM_STATS
+  //claim counters are written once per symbol when the action ends
+  for( const auto& delta : _claim_deltas ) {
+    if( !delta.counted || ( delta.unclaimed_rows == 0 && delta.claimed_rows == 0 && delta.unclaimed_amount == 0 ) ) {
+      continue;
+    }
+
+    claimstats progress( _self, delta.sym_code.raw() );
+    progress.modify( progress.get( delta.sym_code.raw() ), same_payer, [&]( auto& c ){
+      c.unclaimed_rows   += delta.unclaimed_rows;
+      c.unclaimed_amount += delta.unclaimed_amount;
+      c.claimed_rows     += delta.claimed_rows;
+    });
+  }
+#endif
+
+#if TOKEN_EVENT_LOG
+  if( !_events.empty() ) {
+    action( permission_level{ _self, "active"_n }, _self, "logevents"_n, _events ).send();
+  }
+#endif
+
+#if TOKEN_DB_COUNTERS
+  //printed last so the counts include the flushes above
+  const auto& c = db_counters::current();
+  print( "db find ", c.finds, " get ", c.gets, " store ", c.stores,
+         " update ", c.updates, " remove ", c.removes, "\n" );
+#endif
 }
 
 } /// namespace eosio
 
-EOSIO_DISPATCH(eosio::token, (create)(update)(issue)(transfer)(claim)(recover)(burn)(open)(close) )
+extern "C" {
+   [[eosio::wasm_entry]]
+   void apply( uint64_t receiver, uint64_t code, uint64_t action ) {
+      if( code == receiver ) {
+         switch( action ) {
+            EOSIO_DISPATCH_HELPER( eosio::token, (create)(issue)(transfer)(setpolicy)(claim)(burn)(open)(close)(getbalances)(getstats) )
+#if TOKEN_CLAIM_STATS
+            EOSIO_DISPATCH_HELPER( eosio::token, (seedstats)(getramusage) )
+#endif
+#if TOKEN_UPDATE
+            EOSIO_DISPATCH_HELPER( eosio::token, (update) )
+#endif
+#if TOKEN_RECOVER
+            EOSIO_DISPATCH_HELPER( eosio::token, (recover) )
+#endif
+#if TOKEN_BATCH_ACTIONS
+            EOSIO_DISPATCH_HELPER( eosio::token, (sendmany)(airdrop)(distribute)(loadsnap)(burnmany)(claimmany)(openmany)(compact) )
+#endif
+#if TOKEN_RECOVER && TOKEN_BATCH_ACTIONS
+            EOSIO_DISPATCH_HELPER( eosio::token, (recovermany) )
+#endif
+#if TOKEN_RECOVER && TOKEN_UNCLAIMED_REGISTRY
+            EOSIO_DISPATCH_HELPER( eosio::token, (sweep) )
+#endif
+#if TOKEN_MERKLE_CLAIMS
+            EOSIO_DISPATCH_HELPER( eosio::token, (setroot)(claimproof) )
+#endif
+#if TOKEN_VESTING
+            EOSIO_DISPATCH_HELPER( eosio::token, (grant) )
+#endif
+#if TOKEN_EXPIRY
+            EOSIO_DISPATCH_HELPER( eosio::token, (setwindow) )
+#endif
+#if TOKEN_SHARDED_SUPPLY
+            EOSIO_DISPATCH_HELPER( eosio::token, (setshards) )
+#endif
+#if TOKEN_EVENT_LOG
+            EOSIO_DISPATCH_HELPER( eosio::token, (logevents) )
+#endif
+         }
+      }
+   }
+}
@@ -0,0 +1,530 @@
+/**
+ *  @file
+ *  @copyright defined in LICENSE
+ */
+#pragma once
+
+//in-memory stand-in for the parts of eosio.cdt the token uses, so token.cpp builds natively.
+//tables live in host memory, check() throws, and db::snapshot/restore give transaction rollback.
+//serialization and sha256 are simplified, sizes and hashes differ from the chain.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+#define CONTRACT class [[eosio::contract]]
+#define ACTION [[eosio::action]] void
+#define TABLE struct [[eosio::table]]
+
+typedef unsigned __int128 uint128_t;
+typedef __int128          int128_t;
+
+namespace eosio {
+
+   struct check_failure : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline void check( bool pred, const char* msg ) { if( !pred ) throw check_failure( msg ); }
+   inline void check( bool pred, const std::string& msg ) { if( !pred ) throw check_failure( msg ); }
+
+   struct name {
+      uint64_t value = 0;
+
+      constexpr name() = default;
+      constexpr explicit name( uint64_t v ) : value( v ) {}
+      constexpr explicit name( std::string_view s ) : value( 0 ) {
+         auto char_to_value = []( char c ) -> uint64_t {
+            if( c >= 'a' && c <= 'z' ) return ( c - 'a' ) + 6;
+            if( c >= '1' && c <= '5' ) return ( c - '1' ) + 1;
+            return 0;
+         };
+         int i = 0;
+         for( ; i < 12 && i < int( s.size() ); ++i ) {
+            value |= ( char_to_value( s[i] ) & 0x1f ) << ( 64 - 5 * ( i + 1 ) );
+         }
+         if( i == 12 && s.size() > 12 ) {
+            value |= char_to_value( s[12] ) & 0x0f;
+         }
+      }
+
+      enum class raw : uint64_t {};
+      constexpr operator raw()const { return raw( value ); }
+      constexpr explicit operator bool()const { return value != 0; }
+
+      friend constexpr bool operator==( name a, name b ) { return a.value == b.value; }
+      friend constexpr bool operator!=( name a, name b ) { return a.value != b.value; }
+      friend constexpr bool operator<( name a, name b ) { return a.value < b.value; }
+      friend constexpr bool operator<=( name a, name b ) { return a.value <= b.value; }
+      friend constexpr bool operator>( name a, name b ) { return a.value > b.value; }
+   };
+
+   inline namespace literals {
+      template<typename T, T... Str>
+      inline constexpr name operator""_n() {
+         constexpr char s[] = { Str..., 0 };
+         return name( std::string_view( s, sizeof...( Str ) ) );
+      }
+   }
+
+   static constexpr name same_payer{};
+
+   struct symbol_code {
+      uint64_t value = 0;
+
+      constexpr symbol_code() = default;
+      constexpr explicit symbol_code( uint64_t raw ) : value( raw ) {}
+      explicit symbol_code( std::string_view s ) {
+         for( int i = int( s.size() ) - 1; i >= 0; --i ) {
+            value = ( value << 8 ) | uint64_t( s[i] );
+         }
+      }
+
+      constexpr uint64_t raw()const { return value; }
+      bool is_valid()const { return value != 0; }
+
+      friend bool operator==( symbol_code a, symbol_code b ) { return a.value == b.value; }
+      friend bool operator!=( symbol_code a, symbol_code b ) { return a.value != b.value; }
+      friend bool operator<( symbol_code a, symbol_code b ) { return a.value < b.value; }
+   };
+
+   struct symbol {
+      uint64_t value = 0;
+
+      constexpr symbol() = default;
+      constexpr explicit symbol( uint64_t raw ) : value( raw ) {}
+      symbol( symbol_code code, uint8_t precision ) : value( ( code.raw() << 8 ) | precision ) {}
+      symbol( std::string_view code, uint8_t precision ) : symbol( symbol_code( code ), precision ) {}
+
+      uint64_t    raw()const { return value; }
+      symbol_code code()const { return symbol_code{ value >> 8 }; }
+      uint8_t     precision()const { return value & 0xff; }
+      bool        is_valid()const { return code().is_valid(); }
+
+      friend bool operator==( symbol a, symbol b ) { return a.value == b.value; }
+      friend bool operator!=( symbol a, symbol b ) { return a.value != b.value; }
+   };
+
+   struct asset {
+      static constexpr int64_t max_amount = ( 1LL << 62 ) - 1;
+
+      int64_t       amount = 0;
+      eosio::symbol symbol;
+
+      asset() = default;
+      asset( int64_t a, eosio::symbol s ) : amount( a ), symbol( s ) {
+         check( is_amount_within_range(), "magnitude of asset amount must be less than 2^62" );
+      }
+
+      bool is_amount_within_range()const { return -max_amount <= amount && amount <= max_amount; }
+      bool is_valid()const { return is_amount_within_range() && symbol.is_valid(); }
+
+      asset& operator+=( const asset& a ) {
+         check( a.symbol == symbol, "attempt to add asset with different symbol" );
+         amount += a.amount;
+         check( -max_amount <= amount, "addition underflow" );
+         check( amount <= max_amount, "addition overflow" );
+         return *this;
+      }
+      asset& operator-=( const asset& a ) {
+         check( a.symbol == symbol, "attempt to subtract asset with different symbol" );
+         amount -= a.amount;
+         check( -max_amount <= amount, "subtraction underflow" );
+         check( amount <= max_amount, "subtraction overflow" );
+         return *this;
+      }
+      asset operator-()const { asset r = *this; r.amount = -amount; return r; }
+
+      friend asset operator+( asset a, const asset& b ) { a += b; return a; }
+      friend asset operator-( asset a, const asset& b ) { a -= b; return a; }
+      friend bool operator==( const asset& a, const asset& b ) { return a.amount == b.amount && a.symbol == b.symbol; }
+   };
+
+   struct checksum256 {
+      std::array<uint8_t, 32> bytes{};
+
+      std::array<uint8_t, 32> extract_as_byte_array()const { return bytes; }
+
+      friend bool operator==( const checksum256& a, const checksum256& b ) { return a.bytes == b.bytes; }
+      friend bool operator!=( const checksum256& a, const checksum256& b ) { return a.bytes != b.bytes; }
+      friend bool operator<( const checksum256& a, const checksum256& b ) { return a.bytes < b.bytes; }
+   };
+
+   //not sha256, a deterministic 32 byte mix that is enough for merkle proofs and shard picks
+   inline checksum256 sha256( const char* data, size_t size ) {
+      checksum256 result;
+      uint64_t h = 1469598103934665603ULL;
+      for( size_t i = 0; i < size; ++i ) {
+         h ^= uint8_t( data[i] );
+         h *= 1099511628211ULL;
+      }
+      for( int i = 0; i < 32; ++i ) {
+         result.bytes[i] = ( h >> ( ( i % 8 ) * 8 ) ) & 0xff;
+         h = h * 31 + i;
+      }
+      return result;
+   }
+
+   struct time_point {
+      int64_t elapsed_us = 0;
+      uint32_t sec_since_epoch()const { return uint32_t( elapsed_us / 1000000 ); }
+   };
+
+   struct time_point_sec {
+      uint32_t utc_seconds = 0;
+      uint32_t sec_since_epoch()const { return utc_seconds; }
+   };
+
+   //state of the simulated chain around the action being executed
+   struct host {
+      static std::vector<name>& auths()    { static std::vector<name> a; return a; }
+      static std::vector<name>& notified() { static std::vector<name> n; return n; }
+      static std::vector<name>& accounts() { static std::vector<name> a; return a; }
+      static int64_t&           now_us()   { static int64_t n = 0; return n; }
+      static std::string&       console()  { static std::string c; return c; }
+   };
+
+   inline void require_auth( name n ) {
+      auto& a = host::auths();
+      check( std::find( a.begin(), a.end(), n ) != a.end(), "missing required authority" );
+   }
+   inline bool has_auth( name n ) {
+      auto& a = host::auths();
+      return std::find( a.begin(), a.end(), n ) != a.end();
+   }
+   inline bool is_account( name n ) {
+      auto& a = host::accounts();
+      return std::find( a.begin(), a.end(), n ) != a.end();
+   }
+   inline void require_recipient( name n ) { host::notified().push_back( n ); }
+   inline time_point current_time_point() { return time_point{ host::now_us() }; }
+
+   inline void print_value( std::string& out, const char* s ) { out += s; }
+   inline void print_value( std::string& out, const std::string& s ) { out += s; }
+   template<typename T>
+   inline std::enable_if_t<std::is_arithmetic_v<T>> print_value( std::string& out, T v ) { out += std::to_string( v ); }
+
+   template<typename... Args>
+   void print( Args&&... args ) { ( print_value( host::console(), args ), ... ); }
+
+   //byte copy of trivially copyable values, strings are length prefixed
+   template<typename T>
+   void pack_to( std::vector<char>& out, const T& v ) {
+      if constexpr( std::is_same_v<T, std::string> ) {
+         pack_to( out, uint32_t( v.size() ) );
+         out.insert( out.end(), v.begin(), v.end() );
+      } else {
+         static_assert( std::is_trivially_copyable_v<T>, "mock pack only handles plain values and strings" );
+         const char* p = reinterpret_cast<const char*>( &v );
+         out.insert( out.end(), p, p + sizeof( T ) );
+      }
+   }
+
+   template<typename... Ts>
+   void pack_to( std::vector<char>& out, const std::tuple<Ts...>& t ) {
+      std::apply( [&]( const auto&... e ) { ( pack_to( out, e ), ... ); }, t );
+   }
+
+   template<typename T>
+   std::vector<char> pack( const T& v ) {
+      std::vector<char> out;
+      pack_to( out, v );
+      return out;
+   }
+
+   template<typename T>
+   size_t pack_size( const T& v ) { return pack( v ).size(); }
+
+   class contract {
+      public:
+         contract( name self, name first_receiver, int ) : _self( self ), _first_receiver( first_receiver ) {}
+
+         name get_self()const { return _self; }
+         name get_first_receiver()const { return _first_receiver; }
+
+      protected:
+         name _self;
+         name _first_receiver;
+   };
+
+   struct permission_level {
+      name actor;
+      name permission;
+   };
+
+   //inline actions are recorded by name, their payload is dropped
+   struct action {
+      name account;
+      name action_name;
+
+      template<typename... T>
+      action( permission_level, name a, name n, T&&... ) : account( a ), action_name( n ) {}
+
+      void send()const { sent().push_back( action_name ); }
+
+      static std::vector<name>& sent() { static std::vector<name> s; return s; }
+   };
+
+   template<typename T>
+   struct binary_extension {
+      std::optional<T> _value;
+
+      bool     has_value()const { return _value.has_value(); }
+      const T& value()const { return *_value; }
+      T        value_or( T def = T{} )const { return _value ? *_value : def; }
+      void     emplace( const T& v ) { _value = v; }
+   };
+
+   //every table row of every contract, keyed by (code, scope, table) and primary key
+   struct db {
+      struct row {
+         uint64_t              payer = 0;
+         std::shared_ptr<void> obj;
+         std::shared_ptr<void> ( *clone )( const void* ) = nullptr;
+      };
+
+      typedef std::map<uint64_t, row>                                           rows;
+      typedef std::map<std::tuple<uint64_t, uint64_t, uint64_t>, rows>         table_map;
+
+      struct counts {
+         uint64_t finds   = 0;
+         uint64_t stores  = 0;
+         uint64_t updates = 0;
+         uint64_t removes = 0;
+      };
+
+      static table_map& tables() { static table_map t; return t; }
+      static counts&    calls()  { static counts c; return c; }
+
+      template<typename T>
+      static std::shared_ptr<void> clone_of( const void* p ) { return std::make_shared<T>( *static_cast<const T*>( p ) ); }
+
+      //deep copy, rows are modified in place so sharing them would leak into the snapshot
+      static table_map snapshot() {
+         table_map copy = tables();
+         for( auto& [key, table] : copy ) {
+            for( auto& [pk, r] : table ) {
+               r.obj = r.clone( r.obj.get() );
+            }
+         }
+         return copy;
+      }
+
+      static void restore( table_map state ) { tables() = std::move( state ); }
+   };
+
+   template<name::raw IndexName, typename Extractor>
+   struct indexed_by {
+      static constexpr uint64_t index_name = uint64_t( IndexName );
+      using extractor = Extractor;
+   };
+
+   template<typename T, typename Key, Key (T::*Fn)()const>
+   struct const_mem_fun {
+      Key operator()( const T& t )const { return ( t.*Fn )(); }
+   };
+
+   template<uint64_t N, typename... Indices> struct find_index;
+   template<uint64_t N> struct find_index<N> { using type = void; };
+   template<uint64_t N, typename Head, typename... Tail>
+   struct find_index<N, Head, Tail...> {
+      using type = std::conditional_t<Head::index_name == N, Head, typename find_index<N, Tail...>::type>;
+   };
+
+   template<name::raw TableName, typename T, typename... Indices>
+   class multi_index {
+      name     _code;
+      uint64_t _scope;
+
+      db::rows& table()const { return db::tables()[{ _code.value, _scope, uint64_t( TableName ) }]; }
+
+      //the contract can always bill itself, any other payer has to sign the action
+      bool may_bill( name payer )const { return payer == _code || has_auth( payer ); }
+
+      public:
+         multi_index( name code, uint64_t scope ) : _code( code ), _scope( scope ) {}
+
+         uint64_t get_scope()const { return _scope; }
+
+         struct const_iterator {
+            db::rows*          rows;
+            db::rows::iterator it;
+
+            const T& operator*()const { return *std::static_pointer_cast<T>( it->second.obj ); }
+            const T* operator->()const { return std::static_pointer_cast<T>( it->second.obj ).get(); }
+            const_iterator& operator++() { ++it; return *this; }
+            bool operator==( const const_iterator& o )const { return it == o.it; }
+            bool operator!=( const const_iterator& o )const { return it != o.it; }
+         };
+
+         const_iterator begin()const { auto& t = table(); return { &t, t.begin() }; }
+         const_iterator end()const { auto& t = table(); return { &t, t.end() }; }
+
+         const_iterator find( uint64_t pk )const {
+            ++db::calls().finds;
+            auto& t = table();
+            return { &t, t.find( pk ) };
+         }
+
+         const T& get( uint64_t pk, const char* error_msg = "unable to find key" )const {
+            auto it = find( pk );
+            check( it != end(), error_msg );
+            return *it;
+         }
+
+         template<typename Lambda>
+         const_iterator emplace( name payer, Lambda&& constructor ) {
+            check( payer.value != 0, "must specify a valid account to pay for new record" );
+            check( may_bill( payer ), "unauthorized ram usage increase" );
+            auto obj = std::make_shared<T>();
+            constructor( *obj );
+            auto& t = table();
+            auto pk = obj->primary_key();
+            check( t.find( pk ) == t.end(), "could not insert object, most likely a uniqueness constraint was violated" );
+            ++db::calls().stores;
+            auto inserted = t.emplace( pk, db::row{ payer.value, obj, &db::clone_of<T> } );
+            return { &t, inserted.first };
+         }
+
+         template<typename Lambda>
+         void modify( const_iterator itr, name payer, Lambda&& updater ) { modify( *itr, payer, updater ); }
+
+         template<typename Lambda>
+         void modify( const T& obj, name payer, Lambda&& updater ) {
+            auto& t = table();
+            auto pk = obj.primary_key();
+            auto it = t.find( pk );
+            check( it != t.end(), "cannot modify objects in table of another contract" );
+            auto& stored = *std::static_pointer_cast<T>( it->second.obj );
+            updater( stored );
+            check( stored.primary_key() == pk, "updater cannot change primary key when modifying an object" );
+            //like the chain, moving a row to another payer needs that payer's authorization
+            check( payer.value == 0 || payer.value == it->second.payer || may_bill( payer ), "unauthorized ram usage increase" );
+            if( payer.value != 0 ) {
+               it->second.payer = payer.value;
+            }
+            ++db::calls().updates;
+         }
+
+         const_iterator erase( const_iterator itr ) {
+            auto next = std::next( itr.it );
+            ++db::calls().removes;
+            itr.rows->erase( itr.it );
+            return { itr.rows, next };
+         }
+
+         void erase( const T& obj ) {
+            auto& t = table();
+            auto it = t.find( obj.primary_key() );
+            check( it != t.end(), "attempt to remove object that was not in multi_index" );
+            ++db::calls().removes;
+            t.erase( it );
+         }
+
+         //ordered by the extractor, built when iteration starts
+         template<typename Extractor>
+         struct secondary_index {
+            db::rows* rows;
+
+            struct iterator {
+               std::shared_ptr<std::vector<uint64_t>> order;
+               size_t                                 pos = 0;
+               db::rows*                              rows = nullptr;
+
+               const T& operator*()const { return *std::static_pointer_cast<T>( rows->at( ( *order )[pos] ).obj ); }
+               const T* operator->()const { return &**this; }
+               iterator& operator++() { ++pos; return *this; }
+               bool at_end()const { return !order || pos >= order->size(); }
+               bool operator==( const iterator& o )const {
+                  if( at_end() || o.at_end() ) return at_end() == o.at_end();
+                  return ( *order )[pos] == ( *o.order )[o.pos];
+               }
+               bool operator!=( const iterator& o )const { return !( *this == o ); }
+            };
+
+            iterator begin()const {
+               std::vector<std::pair<uint64_t, uint64_t>> keys;
+               for( const auto& [pk, r] : *rows ) {
+                  keys.emplace_back( Extractor()( *std::static_pointer_cast<T>( r.obj ) ), pk );
+               }
+               std::sort( keys.begin(), keys.end() );
+               auto order = std::make_shared<std::vector<uint64_t>>();
+               for( const auto& k : keys ) {
+                  order->push_back( k.second );
+               }
+               ++db::calls().finds;
+               return iterator{ order, 0, rows };
+            }
+            iterator end()const { return iterator{ nullptr, 0, rows }; }
+         };
+
+         template<name::raw IndexName>
+         auto get_index()const {
+            using index = typename find_index<uint64_t( IndexName ), Indices...>::type;
+            return secondary_index<typename index::extractor>{ &table() };
+         }
+
+         //host side only, the chain has no getter for this
+         uint64_t payer_of( uint64_t pk )const { return table().at( pk ).payer; }
+   };
+
+   //one row per scope, kept in the same table map so snapshots cover it
+   template<name::raw SingletonName, typename T>
+   class singleton {
+      struct row {
+         T value;
+         uint64_t primary_key()const { return uint64_t( SingletonName ); }
+      };
+
+      multi_index<SingletonName, row> _table;
+
+      public:
+         singleton( name code, uint64_t scope ) : _table( code, scope ) {}
+
+         bool exists()const { return _table.find( uint64_t( SingletonName ) ) != _table.end(); }
+         T    get()const { return _table.get( uint64_t( SingletonName ), "singleton does not exist" ).value; }
+         T    get_or_default( const T& def = T() )const { return exists() ? get() : def; }
+
+         void set( const T& value, name payer ) {
+            auto it = _table.find( uint64_t( SingletonName ) );
+            if( it == _table.end() ) {
+               _table.emplace( payer, [&]( auto& r ) { r.value = value; } );
+            } else {
+               _table.modify( it, payer, [&]( auto& r ) { r.value = value; } );
+            }
+         }
+
+         void remove() {
+            auto it = _table.find( uint64_t( SingletonName ) );
+            if( it != _table.end() ) {
+               _table.erase( it );
+            }
+         }
+   };
+
+   //the dispatcher only has to compile, tests call the actions directly
+   template<typename T, typename R, typename... Args>
+   bool execute_action( name, name, R (T::*)( Args... ) ) { return true; }
+
+} /// namespace eosio
+
+#define EOSIO_DISPATCH_INTERNAL( r, OP, elem ) \
+   case eosio::name( BOOST_PP_STRINGIZE( elem ) ).value: \
+      eosio::execute_action( eosio::name( receiver ), eosio::name( code ), &OP::elem ); \
+      break;
+
+#define EOSIO_DISPATCH_HELPER( TYPE, MEMBERS ) BOOST_PP_SEQ_FOR_EACH( EOSIO_DISPATCH_INTERNAL, TYPE, MEMBERS )
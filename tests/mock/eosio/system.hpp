@@ -0,0 +1,8 @@
+/**
+ *  @file
+ *  @copyright defined in LICENSE
+ */
+#pragma once
+
+//everything is declared in eosio.hpp
+#include "eosio.hpp"
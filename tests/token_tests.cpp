@@ -0,0 +1,970 @@
+/**
+ *  @file
+ *  @copyright defined in LICENSE
+ */
+
+//host tests of the token contract built against the headers in mock/.
+//fixed scenarios cover the claim flows of the build, then random actions check after every
+//action that supply, claim counters, registry, expiry queue and vesting rows agree with the balances
+
+#include <eosio/eosio.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+//the checks read the tables and helpers declared private in token.hpp
+#define private public
+#include "../src/token.cpp"
+#undef private
+
+using namespace eosio;
+
+namespace {
+
+   const name self = "tulip.token"_n;
+
+   //what the failed check was doing, printed with the failure
+   std::string context = "scenarios";
+
+   void fail( int line, const char* expr ) {
+      std::cerr << "FAILED line " << line << " (" << context << "): " << expr << "\n";
+      std::exit( 1 );
+   }
+
+   #define REQUIRE( expr ) do { if( !( expr ) ) fail( __LINE__, #expr ); } while( 0 )
+
+   //database calls of successful actions, reported at the end
+   struct action_cost {
+      uint64_t runs    = 0;
+      uint64_t finds   = 0;
+      uint64_t stores  = 0;
+      uint64_t updates = 0;
+      uint64_t removes = 0;
+   };
+
+   std::map<std::string, action_cost> costs;
+
+   //runs one action as a transaction, a failed check rolls back every table like the chain does
+   template<typename F>
+   bool push( const std::string& action_name, std::vector<name> auths, F&& apply, std::string* error = nullptr ) {
+      auto state = db::snapshot();
+      host::auths() = std::move( auths );
+      host::notified().clear();
+      host::console().clear();
+      action::sent().clear();
+#if TOKEN_DB_COUNTERS
+      db_counters::current() = db_counters{};
+#endif
+      const auto before = db::calls();
+
+      try {
+         //the destructor flushes the pending writes before the catch
+         token contract( self, self, 0 );
+         apply( contract );
+      } catch( const check_failure& e ) {
+         db::restore( std::move( state ) );
+         if( error ) {
+            *error = e.what();
+         }
+         return false;
+      }
+
+      const auto& after = db::calls();
+      auto& cost = costs[action_name];
+      ++cost.runs;
+      cost.finds   += after.finds - before.finds;
+      cost.stores  += after.stores - before.stores;
+      cost.updates += after.updates - before.updates;
+      cost.removes += after.removes - before.removes;
+      return true;
+   }
+
+   template<typename F>
+   void expect_ok( int line, const std::string& action_name, std::vector<name> auths, F&& apply ) {
+      std::string error;
+      if( !push( action_name, std::move( auths ), std::forward<F>( apply ), &error ) ) {
+         std::cerr << action_name << ": " << error << "\n";
+         fail( line, "action succeeds" );
+      }
+   }
+
+   template<typename F>
+   void expect_fail( int line, const std::string& action_name, std::vector<name> auths, F&& apply ) {
+      if( push( action_name, std::move( auths ), std::forward<F>( apply ) ) ) {
+         fail( line, "action fails" );
+      }
+   }
+
+   #define OK( action_name, auths, body ) expect_ok( __LINE__, action_name, auths, [&]( token& t ) { body; } )
+   #define FAILS( action_name, auths, body ) expect_fail( __LINE__, action_name, auths, [&]( token& t ) { body; } )
+
+   void reset_chain( const std::vector<name>& accounts ) {
+      db::tables().clear();
+      host::accounts() = accounts;
+      host::accounts().push_back( self );
+      host::now_us() = 1600000000LL * 1000000;
+   }
+
+   void advance( uint32_t seconds ) { host::now_us() += int64_t( seconds ) * 1000000; }
+
+   const token::account* find_row( name owner, const symbol& sym ) {
+      token::accounts acnts( self, owner.value );
+      auto it = acnts.find( sym.code().raw() );
+      return it == acnts.end() ? nullptr : &*it;
+   }
+
+   //-1 when there is no row
+   int64_t balance( name owner, const symbol& sym ) {
+      auto row = find_row( owner, sym );
+      return row ? row->balance.amount : -1;
+   }
+
+   bool claimed( name owner, const symbol& sym ) {
+      auto row = find_row( owner, sym );
+      REQUIRE( row != nullptr );
+      return row->claimed;
+   }
+
+   uint64_t payer( name owner, const symbol& sym ) {
+      token::accounts acnts( self, owner.value );
+      return acnts.payer_of( sym.code().raw() );
+   }
+
+   int64_t supply( const symbol& sym ) { return token::get_supply( self, sym.code() ).amount; }
+
+#if TOKEN_MERKLE_CLAIMS
+   checksum256 leaf_hash( name owner, const asset& amount ) {
+      auto leaf = pack( std::make_tuple( owner, amount ) );
+      return sha256( leaf.data(), leaf.size() );
+   }
+
+   checksum256 node_hash( const checksum256& a, const checksum256& b ) {
+      auto lhs = std::min( a, b ).extract_as_byte_array();
+      auto rhs = std::max( a, b ).extract_as_byte_array();
+      std::array<uint8_t, 64> pair;
+      std::copy( lhs.begin(), lhs.end(), pair.begin() );
+      std::copy( rhs.begin(), rhs.end(), pair.begin() + 32 );
+      return sha256( reinterpret_cast<const char*>( pair.data() ), pair.size() );
+   }
+
+   //tree of four leaves, proof of leaf i is its sibling and the other half
+   struct merkle_tree {
+      std::vector<std::pair<name, asset>> leaves;
+
+      checksum256 hash( size_t i )const { return leaf_hash( leaves[i].first, leaves[i].second ); }
+      checksum256 half( size_t i )const { return node_hash( hash( i ), hash( i ^ 1 ) ); }
+      checksum256 root()const { return node_hash( half( 0 ), half( 2 ) ); }
+      std::vector<checksum256> proof( size_t i )const { return { hash( i ^ 1 ), half( i ^ 2 ) }; }
+   };
+#endif
+
+   //table rows of one symbol as the checks see them
+   struct symbol_rows {
+      const token::currency_stats* stats = nullptr;
+      int64_t                      balances = 0;
+      std::set<uint64_t>           unclaimed_owners;
+      std::set<uint64_t>           owners;
+      //accounts row of every owner, ordered like seedstats pages
+      std::map<uint64_t, const token::account*> rows;
+   };
+
+   template<typename T>
+   const T& row_of( const db::row& r ) { return *std::static_pointer_cast<T>( r.obj ); }
+
+   void check_invariants() {
+      std::map<uint64_t, symbol_rows> symbols;
+      std::map<uint64_t, const db::rows*> claim_progress;
+      std::map<uint64_t, const db::rows*> shards;
+      std::map<uint64_t, const db::rows*> registries;
+      std::map<uint64_t, const db::rows*> queues;
+      std::vector<std::pair<uint64_t, uint64_t>> schedules;
+
+      for( const auto& [key, rows] : db::tables() ) {
+         const auto& [code, scope, table] = key;
+         REQUIRE( code == self.value );
+         if( table == "stat"_n.value ) {
+            for( const auto& [pk, r] : rows ) {
+               symbols[pk].stats = &row_of<token::currency_stats>( r );
+            }
+         } else if( table == "claimstats"_n.value ) {
+            claim_progress[scope] = &rows;
+         } else if( table == "supplyshard"_n.value ) {
+            shards[scope] = &rows;
+         } else if( table == "unclaimed"_n.value ) {
+            registries[scope] = &rows;
+         } else if( table == "expiries"_n.value ) {
+            queues[scope] = &rows;
+         } else if( table == "vestings"_n.value ) {
+            for( const auto& [pk, r] : rows ) {
+               schedules.emplace_back( scope, pk );
+            }
+         }
+      }
+
+      for( const auto& [key, rows] : db::tables() ) {
+         if( std::get<2>( key ) != "accounts"_n.value ) {
+            continue;
+         }
+         const uint64_t owner = std::get<1>( key );
+         for( const auto& [pk, r] : rows ) {
+            const auto& a = row_of<token::account>( r );
+            REQUIRE( symbols.count( pk ) && symbols[pk].stats );
+            auto& s = symbols[pk];
+            REQUIRE( a.balance.symbol == s.stats->supply.symbol );
+            REQUIRE( a.balance.amount >= 0 );
+            s.balances += a.balance.amount;
+            s.owners.insert( owner );
+            s.rows[owner] = &a;
+            if( !a.claimed ) {
+               //zero rows are erased on debit and only opened claimed
+               REQUIRE( a.balance.amount > 0 );
+               REQUIRE( r.payer == s.stats->issuer.value );
+               s.unclaimed_owners.insert( owner );
+            }
+         }
+      }
+
+      for( const auto& [code, s] : symbols ) {
+         REQUIRE( s.stats != nullptr );
+         const auto current = token::current_supply( self, *s.stats ).amount;
+         REQUIRE( current == s.balances );
+         REQUIRE( current <= s.stats->max_supply.amount );
+
+#if TOKEN_CLAIM_STATS
+         //a symbol without a counters row is not counted, a seeding one up to its cursor
+         auto progress = claim_progress.find( code );
+         if( progress != claim_progress.end() && !progress->second->empty() ) {
+            REQUIRE( progress->second->size() == 1 );
+            const auto& counters = row_of<token::claim_stats>( progress->second->begin()->second );
+            token::claim_stats expected;
+            for( const auto& [owner, a] : s.rows ) {
+               if( !counters.seeded && owner > counters.seed_cursor.value ) {
+                  break;
+               }
+               if( a->claimed ) {
+                  ++expected.claimed_rows;
+               } else {
+                  ++expected.unclaimed_rows;
+                  expected.unclaimed_amount += a->balance.amount;
+               }
+            }
+            REQUIRE( counters.unclaimed_rows == expected.unclaimed_rows );
+            REQUIRE( counters.unclaimed_amount == expected.unclaimed_amount );
+            REQUIRE( counters.claimed_rows == expected.claimed_rows );
+         }
+#else
+         REQUIRE( claim_progress.empty() );
+#endif
+
+         const uint8_t shard_count = s.stats->shards.value_or( 0 );
+         auto shard_rows = shards.find( code );
+         if( shard_rows != shards.end() ) {
+            REQUIRE( shard_rows->second->empty() || shard_count > 0 );
+            for( const auto& [id, r] : *shard_rows->second ) {
+               REQUIRE( id < shard_count );
+            }
+         }
+
+         std::set<uint64_t> registered;
+         if( registries.count( code ) ) {
+            for( const auto& [owner, r] : *registries[code] ) {
+               registered.insert( owner );
+            }
+         }
+#if TOKEN_UNCLAIMED_REGISTRY
+         REQUIRE( registered == s.unclaimed_owners );
+#else
+         REQUIRE( registered.empty() );
+#endif
+
+         if( queues.count( code ) ) {
+            for( const auto& [owner, r] : *queues[code] ) {
+               REQUIRE( s.unclaimed_owners.count( owner ) );
+            }
+         }
+      }
+
+      for( const auto& [owner, code] : schedules ) {
+         REQUIRE( symbols.count( code ) && symbols[code].owners.count( owner ) );
+      }
+   }
+
+   void run_scenarios() {
+      const name issuer = "issuer"_n, alice = "alice"_n, bob = "bob"_n, carol = "carol"_n;
+      const symbol sym( "TOK", 4 );
+      auto tok = [&]( int64_t amount ) { return asset( amount, sym ); };
+
+      reset_chain( { issuer, alice, bob, carol } );
+      OK( "create", { self }, t.create( issuer, tok( 1000000 ) ) );
+      FAILS( "create", { self }, t.create( issuer, tok( 1000000 ) ) );
+      FAILS( "issue", { alice }, t.issue( issuer, tok( 10 ), "" ) );
+      OK( "issue", { issuer }, t.issue( issuer, tok( 500000 ), "" ) );
+      REQUIRE( balance( issuer, sym ) == 500000 && claimed( issuer, sym ) );
+      FAILS( "issue", { issuer }, t.issue( issuer, tok( 500001 ), "" ) );
+
+#if !TOKEN_SHARDED_SUPPLY
+      {
+         //shard rows left by a sharded build still count
+         token::stats st( self, sym.code().raw() );
+         st.modify( st.get( sym.code().raw() ), same_payer, [&]( auto& s ) {
+            s.claim_policy.emplace( 0 );
+            s.shards.emplace( 2 );
+         });
+         token::supply_shards shardtable( self, sym.code().raw() );
+         shardtable.emplace( self, [&]( auto& r ) { r.id = 1; r.supply = 5; } );
+         REQUIRE( supply( sym ) == 500005 );
+         shardtable.erase( shardtable.get( 1 ) );
+         st.modify( st.get( sym.code().raw() ), same_payer, [&]( auto& s ) { s.shards.emplace( 0 ); } );
+      }
+#else
+      context = "sharded supply";
+      OK( "setshards", { issuer }, t.setshards( sym, 4 ) );
+      FAILS( "setshards", { issuer }, t.setshards( sym, 17 ) );
+      for( int i = 0; i < 8; ++i ) {
+         OK( "issue", { issuer }, t.issue( issuer, tok( 1000 ), std::to_string( i ) ) );
+      }
+      OK( "burn", { issuer }, t.burn( issuer, tok( 500 ) ) );
+      REQUIRE( supply( sym ) == 507500 );
+      check_invariants();
+      FAILS( "issue", { issuer }, t.issue( issuer, tok( 492501 ), "" ) );
+      OK( "setshards", { issuer }, t.setshards( sym, 0 ) );
+      {
+         token::stats st( self, sym.code().raw() );
+         REQUIRE( st.get( sym.code().raw() ).supply.amount == 507500 );
+      }
+      OK( "burn", { issuer }, t.burn( issuer, tok( 7500 ) ) );
+#endif
+      check_invariants();
+
+      context = "claim flow";
+      OK( "transfer", { issuer }, t.transfer( issuer, alice, tok( 100 ), "" ) );
+      REQUIRE( balance( alice, sym ) == 100 && !claimed( alice, sym ) && payer( alice, sym ) == issuer.value );
+      REQUIRE( !token::get_balance_ex( self, alice, sym.code() ).claimed );
+      FAILS( "transfer", { issuer }, t.transfer( issuer, "nobody"_n, tok( 1 ), "" ) );
+      FAILS( "transfer", { alice }, t.transfer( issuer, alice, tok( 1 ), "" ) );
+#if TOKEN_BATCH_ACTIONS
+      OK( "airdrop", { issuer }, t.airdrop( issuer, { { bob, tok( 10 ) }, { carol, tok( 20 ) } }, "" ) );
+      REQUIRE( balance( bob, sym ) == 10 && balance( carol, sym ) == 20 && !claimed( bob, sym ) );
+      REQUIRE( balance( issuer, sym ) == 500000 - 130 );
+      FAILS( "airdrop", { issuer }, t.airdrop( issuer, { { bob, tok( 1 ) }, { issuer, tok( 1 ) } }, "" ) );
+#endif
+      check_invariants();
+
+      //the debit claims the sender row, the credit claims an unclaimed receiver when auto claim is on
+      OK( "transfer", { alice }, t.transfer( alice, bob, tok( 50 ), "" ) );
+      REQUIRE( balance( alice, sym ) == 50 && claimed( alice, sym ) && payer( alice, sym ) == alice.value );
+#if TOKEN_BATCH_ACTIONS
+      REQUIRE( balance( bob, sym ) == 60 && claimed( bob, sym ) == token_config::auto_claim );
+#else
+      REQUIRE( balance( bob, sym ) == 50 && claimed( bob, sym ) );
+#endif
+      FAILS( "transfer", { alice }, t.transfer( alice, bob, tok( 51 ), "" ) );
+      OK( "transfer", { alice }, t.transfer( alice, bob, tok( 50 ), "" ) );
+      REQUIRE( balance( alice, sym ) == -1 );
+      check_invariants();
+
+      context = "open and close";
+      OK( "open", { alice }, t.open( alice, sym, alice ) );
+      REQUIRE( balance( alice, sym ) == 0 && claimed( alice, sym ) );
+      OK( "open", { alice }, t.open( alice, sym, alice ) );
+      FAILS( "close", { bob }, t.close( bob, sym ) );
+      OK( "close", { alice }, t.close( alice, sym ) );
+      FAILS( "close", { alice }, t.close( alice, sym ) );
+      check_invariants();
+
+      context = "claim policy";
+      OK( "transfer", { issuer }, t.transfer( issuer, alice, tok( 40 ), "" ) );
+      FAILS( "setpolicy", { issuer }, t.setpolicy( sym, 3 ) );
+      OK( "setpolicy", { issuer }, t.setpolicy( sym, token::claim_policy::none ) );
+      OK( "transfer", { alice }, t.transfer( alice, bob, tok( 1 ), "" ) );
+      REQUIRE( !claimed( alice, sym ) && payer( alice, sym ) == issuer.value );
+      OK( "setpolicy", { issuer }, t.setpolicy( sym, token::claim_policy::sender ) );
+      OK( "transfer", { alice }, t.transfer( alice, bob, tok( 1 ), "" ) );
+      REQUIRE( claimed( alice, sym ) && payer( alice, sym ) == alice.value );
+      OK( "setpolicy", { issuer }, t.setpolicy( sym, token::claim_policy::receiver ) );
+      OK( "transfer", { alice }, t.transfer( alice, bob, tok( 38 ), "" ) );
+      check_invariants();
+
+#if TOKEN_RECOVER
+      context = "recover";
+      OK( "transfer", { issuer }, t.transfer( issuer, carol, tok( 5 ), "" ) );
+      {
+         const int64_t before = balance( issuer, sym ), held = balance( carol, sym );
+         FAILS( "recover", { carol }, t.recover( carol, sym ) );
+         OK( "recover", { issuer }, t.recover( carol, sym ) );
+         REQUIRE( balance( carol, sym ) == -1 && balance( issuer, sym ) == before + held );
+      }
+      //claimed rows are left alone
+      OK( "recover", { issuer }, t.recover( bob, sym ) );
+      REQUIRE( balance( bob, sym ) > 0 );
+      check_invariants();
+#endif
+
+      context = "claim";
+      OK( "transfer", { issuer }, t.transfer( issuer, carol, tok( 7 ), "" ) );
+      FAILS( "claim", { alice }, t.claim( carol, sym ) );
+      OK( "claim", { carol }, t.claim( carol, sym ) );
+      REQUIRE( claimed( carol, sym ) && payer( carol, sym ) == carol.value );
+      OK( "claim", { carol }, t.claim( carol, sym ) );
+      check_invariants();
+
+#if TOKEN_BATCH_ACTIONS
+      context = "batch actions";
+      {
+         const int64_t total = supply( sym ), held = balance( issuer, sym ), bob_held = balance( bob, sym );
+         OK( "burnmany", { issuer }, t.burnmany( sym, { { issuer, tok( 7 ) }, { bob, tok( 3 ) } } ) );
+         REQUIRE( supply( sym ) == total - 10 && balance( issuer, sym ) == held - 7 && balance( bob, sym ) == bob_held - 3 );
+         FAILS( "burnmany", { issuer }, t.burnmany( sym, { { issuer, asset( 1, symbol( "TOK", 2 ) ) } } ) );
+      }
+      {
+         const name sam = "sam"_n, sue = "sue"_n, hank = "hank"_n;
+         host::accounts().insert( host::accounts().end(), { sam, sue, hank } );
+         //a resubmitted chunk is skipped, a new import id starts over from the empty cursor
+         OK( "loadsnap", { issuer }, t.loadsnap( sym, 1, { { sam, 3 }, { sue, 4 } }, name() ) );
+         OK( "loadsnap", { issuer }, t.loadsnap( sym, 1, { { sam, 3 }, { sue, 4 } }, name() ) );
+         REQUIRE( balance( sam, sym ) == 3 && balance( sue, sym ) == 4 && !claimed( sam, sym ) );
+         FAILS( "loadsnap", { issuer }, t.loadsnap( sym, 2, { { sue, 1 } }, sam ) );
+         OK( "loadsnap", { issuer }, t.loadsnap( sym, 2, { { sam, 1 }, { sue, 1 } }, name() ) );
+         REQUIRE( balance( sam, sym ) == 4 && balance( sue, sym ) == 5 );
+         FAILS( "loadsnap", { issuer }, t.loadsnap( sym, 1, { { sam, 1 } }, name() ) );
+         FAILS( "loadsnap", { issuer }, t.loadsnap( sym, 3, { { sue, 1 }, { sam, 1 } }, name() ) );
+         check_invariants();
+
+         //burns keep the payer and the claimed flag of the holder
+         OK( "airdrop", { issuer }, t.airdrop( issuer, { { hank, tok( 9 ) } }, "" ) );
+         OK( "burnmany", { issuer }, t.burnmany( sym, { { hank, tok( 4 ) } } ) );
+         REQUIRE( balance( hank, sym ) == 5 && !claimed( hank, sym ) && payer( hank, sym ) == issuer.value );
+         OK( "burn", { issuer }, t.burn( hank, tok( 1 ) ) );
+         REQUIRE( balance( hank, sym ) == 4 && !claimed( hank, sym ) && payer( hank, sym ) == issuer.value );
+
+         OK( "claimmany", { alice }, t.claimmany( alice, { { sam, sym }, { sue, sym }, { bob, sym } } ) );
+         REQUIRE( claimed( sam, sym ) && payer( sam, sym ) == alice.value && claimed( sue, sym ) );
+         OK( "sendmany", { sam }, t.sendmany( sam, { { sue, tok( 1 ) }, { hank, tok( 3 ) } }, "" ) );
+         REQUIRE( balance( sam, sym ) == -1 && balance( hank, sym ) == 7 );
+         FAILS( "sendmany", { sue }, t.sendmany( sue, { { hank, tok( 5 ) }, { bob, tok( 5 ) } }, "" ) );
+         OK( "openmany", { alice }, t.openmany( alice, sym, { alice, sam } ) );
+         FAILS( "compact", { alice }, t.compact( sam, { sym } ) );
+         OK( "compact", { sam }, t.compact( sam, { sym } ) );
+         REQUIRE( balance( sam, sym ) == -1 );
+#if TOKEN_RECOVER
+         const name ivy = "ivy"_n;
+         host::accounts().push_back( ivy );
+         OK( "airdrop", { issuer }, t.airdrop( issuer, { { ivy, tok( 6 ) } }, "" ) );
+         OK( "recovermany", { issuer }, t.recovermany( sym, { ivy, sue, "nobody"_n } ) );
+         REQUIRE( balance( ivy, sym ) == -1 && balance( sue, sym ) > 0 );
+#endif
+         check_invariants();
+      }
+#endif
+
+#if TOKEN_UPDATE
+      context = "update";
+      FAILS( "update", { self }, t.update( issuer, tok( 1 ) ) );
+      OK( "update", { self }, t.update( issuer, tok( 2000000 ) ) );
+      OK( "issue", { issuer }, t.issue( issuer, tok( 1000000 ), "" ) );
+      check_invariants();
+#endif
+
+#if TOKEN_MERKLE_CLAIMS
+      context = "merkle claims";
+      {
+         merkle_tree tree{ { { alice, tok( 11 ) }, { bob, tok( 12 ) }, { carol, tok( 13 ) }, { issuer, tok( 14 ) } } };
+         FAILS( "claimproof", { alice }, t.claimproof( alice, tok( 11 ), tree.proof( 0 ) ) );
+         OK( "setroot", { issuer }, t.setroot( sym, tree.root() ) );
+         const int64_t before = balance( carol, sym );
+         FAILS( "claimproof", { carol }, t.claimproof( carol, tok( 14 ), tree.proof( 2 ) ) );
+         OK( "claimproof", { carol }, t.claimproof( carol, tok( 13 ), tree.proof( 2 ) ) );
+         REQUIRE( balance( carol, sym ) == before + 13 );
+         FAILS( "claimproof", { carol }, t.claimproof( carol, tok( 13 ), tree.proof( 2 ) ) );
+         //leaves are totals, a new root that repeats or lowers a leaf pays nothing again
+         OK( "setroot", { issuer }, t.setroot( sym, tree.root() ) );
+         FAILS( "claimproof", { carol }, t.claimproof( carol, tok( 13 ), tree.proof( 2 ) ) );
+         tree.leaves[2].second = tok( 2 );
+         OK( "setroot", { issuer }, t.setroot( sym, tree.root() ) );
+         FAILS( "claimproof", { carol }, t.claimproof( carol, tok( 2 ), tree.proof( 2 ) ) );
+         tree.leaves[2].second = tok( 20 );
+         OK( "setroot", { issuer }, t.setroot( sym, tree.root() ) );
+         OK( "claimproof", { carol }, t.claimproof( carol, tok( 20 ), tree.proof( 2 ) ) );
+         REQUIRE( balance( carol, sym ) == before + 20 );
+         check_invariants();
+      }
+      {
+         //a claim debits the issuer row without moving it from whoever opened it
+         const symbol drop( "DRP", 0 );
+         OK( "create", { self }, t.create( issuer, asset( 1000, drop ) ) );
+         OK( "open", { alice }, t.open( issuer, drop, alice ) );
+         OK( "issue", { issuer }, t.issue( issuer, asset( 100, drop ), "" ) );
+         merkle_tree tree{ { { alice, asset( 1, drop ) }, { bob, asset( 2, drop ) }, { carol, asset( 3, drop ) }, { issuer, asset( 4, drop ) } } };
+         OK( "setroot", { issuer }, t.setroot( drop, tree.root() ) );
+         OK( "claimproof", { bob }, t.claimproof( bob, asset( 2, drop ), tree.proof( 1 ) ) );
+         REQUIRE( balance( issuer, drop ) == 98 && payer( issuer, drop ) == alice.value );
+         check_invariants();
+      }
+#endif
+
+#if TOKEN_VESTING
+      context = "vesting";
+      {
+         const name vera = "vera"_n;
+         host::accounts().push_back( vera );
+         const time_point_sec start{ current_time_point().sec_since_epoch() };
+         FAILS( "grant", { issuer }, t.grant( issuer, vera, tok( 1000 ), start, 0, "" ) );
+         OK( "grant", { issuer }, t.grant( issuer, vera, tok( 1000 ), start, 100, "" ) );
+         FAILS( "grant", { issuer }, t.grant( issuer, vera, tok( 1 ), start, 100, "" ) );
+         advance( 50 );
+         FAILS( "transfer", { vera }, t.transfer( vera, alice, tok( 501 ), "" ) );
+         OK( "transfer", { vera }, t.transfer( vera, alice, tok( 500 ), "" ) );
+         advance( 100 );
+         OK( "transfer", { vera }, t.transfer( vera, alice, tok( 1 ), "" ) );
+         token::vestings vesttable( self, vera.value );
+         REQUIRE( vesttable.begin() == vesttable.end() );
+
+         //the schedule leaves with the recovered row
+         const name wade = "wade"_n;
+         host::accounts().push_back( wade );
+         OK( "grant", { issuer }, t.grant( issuer, wade, tok( 10 ), start, 1000, "" ) );
+#if TOKEN_RECOVER
+         OK( "recover", { issuer }, t.recover( wade, sym ) );
+         token::vestings wadetable( self, wade.value );
+         REQUIRE( balance( wade, sym ) == -1 && wadetable.begin() == wadetable.end() );
+#endif
+         check_invariants();
+      }
+#endif
+
+#if TOKEN_EXPIRY
+      context = "expiry";
+      {
+         const name d1 = "dave"_n, d2 = "erin"_n, d3 = "frank"_n, d4 = "gina"_n;
+         host::accounts().insert( host::accounts().end(), { d1, d2, d3, d4 } );
+         FAILS( "setwindow", { issuer }, t.setwindow( sym, std::numeric_limits<uint32_t>::max() ) );
+         OK( "setwindow", { issuer }, t.setwindow( sym, 100 ) );
+         for( auto owner : { d1, d2, d3 } ) {
+            OK( "transfer", { issuer }, t.transfer( issuer, owner, tok( 5 ), "" ) );
+         }
+         advance( 10 );
+         OK( "transfer", { issuer }, t.transfer( issuer, d4, tok( 5 ), "" ) );
+         OK( "claim", { d1 }, t.claim( d1, sym ) );
+         {
+            token::expiries queue( self, sym.code().raw() );
+            REQUIRE( queue.find( d1.value ) == queue.end() && queue.find( d2.value ) != queue.end() );
+         }
+         advance( 95 );
+         //d2 and d3 expired, the transfer skips its own rows and recovers d3
+         const int64_t held = balance( issuer, sym );
+         OK( "transfer", { issuer }, t.transfer( issuer, d2, tok( 1 ), "" ) );
+         REQUIRE( balance( d3, sym ) == -1 && balance( d2, sym ) == 6 && balance( issuer, sym ) == held - 1 + 5 );
+         OK( "transfer", { d1 }, t.transfer( d1, bob, tok( 1 ), "" ) );
+         REQUIRE( balance( d2, sym ) == -1 && balance( d4, sym ) == 5 );
+         advance( 10 );
+         OK( "claim", { d1 }, t.claim( d1, sym ) );
+         REQUIRE( balance( d4, sym ) == -1 );
+         {
+            token::expiries queue( self, sym.code().raw() );
+            REQUIRE( queue.begin() == queue.end() );
+         }
+         OK( "setwindow", { issuer }, t.setwindow( sym, 0 ) );
+         check_invariants();
+      }
+#endif
+
+#if TOKEN_CLAIM_STATS
+      context = "claim counters";
+      {
+         //a symbol created before the counters has rows but no claimstats row
+         const symbol old( "OLD", 0 );
+         auto coins = [&]( int64_t amount ) { return asset( amount, old ); };
+         OK( "create", { self }, t.create( issuer, coins( 1000 ) ) );
+         OK( "issue", { issuer }, t.issue( issuer, coins( 500 ), "" ) );
+         for( auto owner : { alice, bob, carol } ) {
+            OK( "transfer", { issuer }, t.transfer( issuer, owner, coins( 10 ), "" ) );
+         }
+         OK( "claim", { bob }, t.claim( bob, old ) );
+         token::claimstats progress( self, old.code().raw() );
+         progress.erase( progress.get( old.code().raw() ) );
+
+         //row changes of an unseeded symbol are not counted and getramusage refuses to report
+         OK( "transfer", { issuer }, t.transfer( issuer, alice, coins( 1 ), "" ) );
+         REQUIRE( progress.begin() == progress.end() );
+         FAILS( "getramusage", {}, t.getramusage( old.code() ) );
+         FAILS( "seedstats", { alice }, t.seedstats( old, { alice }, false ) );
+
+         //owners are seeded in pages, changes count once their owner is seeded
+         OK( "seedstats", { issuer }, t.seedstats( old, { alice, bob }, false ) );
+         FAILS( "getramusage", {}, t.getramusage( old.code() ) );
+         FAILS( "seedstats", { issuer }, t.seedstats( old, { alice }, false ) );
+         FAILS( "seedstats", { issuer }, t.seedstats( old, { issuer, carol }, false ) );
+         OK( "transfer", { issuer }, t.transfer( issuer, alice, coins( 2 ), "" ) );
+         OK( "claim", { carol }, t.claim( carol, old ) );
+         check_invariants();
+         OK( "seedstats", { issuer }, t.seedstats( old, { carol, issuer }, true ) );
+         check_invariants();
+         {
+            const auto& counters = progress.get( old.code().raw() );
+            REQUIRE( counters.seeded && counters.unclaimed_rows == 1 && counters.claimed_rows == 3 );
+         }
+         OK( "getramusage", {}, t.getramusage( old.code() ) );
+         FAILS( "seedstats", { issuer }, t.seedstats( old, {}, true ) );
+         OK( "transfer", { alice }, t.transfer( alice, carol, coins( 13 ), "" ) );
+         check_invariants();
+      }
+#endif
+
+#if TOKEN_EVENT_LOG
+      context = "event log";
+      OK( "transfer", { issuer }, t.transfer( issuer, alice, tok( 1 ), "" ) );
+      REQUIRE( action::sent().size() == 1 && action::sent().front() == "logevents"_n );
+      OK( "setpolicy", { issuer }, t.setpolicy( sym, token::claim_policy::receiver ) );
+      REQUIRE( action::sent().empty() );
+#endif
+
+#if TOKEN_DB_COUNTERS
+      context = "db counters";
+      OK( "transfer", { issuer }, t.transfer( issuer, alice, tok( 1 ), "" ) );
+      REQUIRE( host::console().find( "db find " ) == 0 );
+#endif
+
+      context = "query actions";
+      {
+         std::vector<token::balance_result> balances;
+         OK( "getbalances", {}, balances = t.getbalances( issuer, { sym.code() } ) );
+         REQUIRE( balances.size() == 1 && balances.front().balance.amount == balance( issuer, sym ) );
+         std::vector<token::stats_result> stats;
+         OK( "getstats", {}, stats = t.getstats( { sym.code() } ) );
+         REQUIRE( stats.size() == 1 && stats.front().supply.amount == supply( sym ) );
+#if TOKEN_CLAIM_STATS
+         token::ram_result ram;
+         OK( "getramusage", {}, ram = t.getramusage( sym.code() ) );
+         REQUIRE( ram.claimed_bytes > 0 && ram.unclaimed_bytes >= 0 );
+#endif
+         FAILS( "getstats", {}, t.getstats( { symbol_code( "NONE" ) } ) );
+      }
+      check_invariants();
+   }
+
+   //random actions by a few holders of two symbols, most of them valid
+   void run_random( uint64_t steps, uint64_t seed ) {
+      const std::vector<name> holders = { "mint"_n, "press"_n, "alice"_n, "bob"_n, "carol"_n,
+                                          "dave"_n, "erin"_n, "frank"_n, "gina"_n, "hank"_n };
+      struct token_info {
+         symbol sym;
+         name   issuer;
+      };
+      const std::vector<token_info> tokens = { { symbol( "TOK", 4 ), "mint"_n }, { symbol( "GEM", 2 ), "press"_n } };
+      reset_chain( holders );
+
+      std::mt19937_64 rng( seed );
+      auto below = [&]( uint64_t n ) { return n == 0 ? 0 : rng() % n; };
+      auto any_holder = [&]() { return holders[below( holders.size() )]; };
+      auto any_token = [&]() { return tokens[below( tokens.size() )]; };
+      //mostly within the balance so debits usually succeed, often all of it so rows are erased
+      auto amount_for = [&]( name owner, const symbol& sym ) {
+         const int64_t held = std::max<int64_t>( balance( owner, sym ), 0 );
+         if( held > 0 && below( 4 ) == 0 ) {
+            return asset( held, sym );
+         }
+         return asset( 1 + int64_t( below( held * 5 / 4 + 3 ) ), sym );
+      };
+      [[maybe_unused]] auto some_holders = [&]( size_t at_most ) {
+         std::vector<name> owners;
+         for( size_t n = 1 + below( at_most ); n > 0; --n ) {
+            owners.push_back( any_holder() );
+         }
+         return owners;
+      };
+
+      for( const auto& info : tokens ) {
+         OK( "create", { self }, t.create( info.issuer, asset( 1000000000, info.sym ) ) );
+      }
+#if TOKEN_CLAIM_STATS
+      //the second symbol starts like one created before the counters and is seeded in random pages
+      {
+         token::claimstats progress( self, tokens[1].sym.code().raw() );
+         progress.erase( progress.get( tokens[1].sym.code().raw() ) );
+      }
+#endif
+
+      std::vector<std::function<void()>> moves;
+      auto add_move = [&]( unsigned weight, std::function<void()> move ) {
+         moves.insert( moves.end(), weight, move );
+      };
+
+      add_move( 3, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const int64_t amount = 1 + below( 100000 );
+         push( "issue", { issuer }, [&]( token& t ) { t.issue( issuer, asset( amount, sym ), std::to_string( rng() % 16 ) ); } );
+      });
+      add_move( 12, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const name from = below( 3 ) == 0 ? issuer : any_holder(), to = any_holder();
+         const auto quantity = amount_for( from, sym );
+         push( "transfer", { from }, [&]( token& t ) { t.transfer( from, to, quantity, "" ); } );
+      });
+      add_move( 3, [&]() {
+         const auto sym = any_token().sym;
+         const name owner = any_holder();
+         push( "claim", { owner }, [&]( token& t ) { t.claim( owner, sym ); } );
+      });
+      add_move( 2, [&]() {
+         const auto sym = any_token().sym;
+         const name owner = any_holder(), ram_payer = any_holder();
+         push( "open", { ram_payer }, [&]( token& t ) { t.open( owner, sym, ram_payer ); } );
+      });
+      add_move( 2, [&]() {
+         const auto sym = any_token().sym;
+         const name owner = any_holder();
+         push( "close", { owner }, [&]( token& t ) { t.close( owner, sym ); } );
+      });
+      add_move( 2, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const name from = any_holder();
+         const auto quantity = amount_for( from, sym );
+         push( "burn", { issuer }, [&]( token& t ) { t.burn( from, quantity ); } );
+      });
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const uint8_t policy = below( 4 );
+         push( "setpolicy", { issuer }, [&]( token& t ) { t.setpolicy( sym, policy ); } );
+      });
+#if TOKEN_CLAIM_STATS
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         token::claimstats progress( self, sym.code().raw() );
+         auto existing = progress.find( sym.code().raw() );
+         const name cursor = existing == progress.end() ? name() : existing->seed_cursor;
+         std::vector<name> remaining;
+         for( const auto& owner : holders ) {
+            if( owner > cursor ) {
+               remaining.push_back( owner );
+            }
+         }
+         std::sort( remaining.begin(), remaining.end() );
+         const std::vector<name> owners( remaining.begin(), remaining.begin() + std::min<size_t>( remaining.size(), below( 4 ) ) );
+         const bool done = owners.size() == remaining.size() && below( 2 ) == 0;
+         push( "seedstats", { issuer }, [&]( token& t ) { t.seedstats( sym, owners, done ); } );
+      });
+      add_move( 1, [&]() {
+         const auto sym = any_token().sym;
+         push( "getramusage", {}, [&]( token& t ) { t.getramusage( sym.code() ); } );
+      });
+#endif
+#if TOKEN_UPDATE
+      add_move( 1, [&]() {
+         //the issuer stays, unclaimed rows are billed to it
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const asset maximum( supply( sym ) + int64_t( below( 1000000000 ) ), sym );
+         push( "update", { self }, [&]( token& t ) { t.update( issuer, maximum ); } );
+      });
+#endif
+#if TOKEN_RECOVER
+      add_move( 2, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const name owner = any_holder();
+         push( "recover", { issuer }, [&]( token& t ) { t.recover( owner, sym ); } );
+      });
+#if TOKEN_BATCH_ACTIONS
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const auto owners = some_holders( 4 );
+         push( "recovermany", { issuer }, [&]( token& t ) { t.recovermany( sym, owners ); } );
+      });
+#endif
+#if TOKEN_UNCLAIMED_REGISTRY
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const uint32_t max_rows = below( 4 );
+         push( "sweep", { issuer }, [&]( token& t ) { t.sweep( sym, max_rows ); } );
+      });
+#endif
+#endif
+#if TOKEN_BATCH_ACTIONS
+      add_move( 3, [&]() {
+         const name from = any_holder();
+         std::vector<std::pair<name, asset>> transfers;
+         for( const auto& to : some_holders( 3 ) ) {
+            transfers.emplace_back( to, amount_for( from, any_token().sym ) );
+         }
+         push( "sendmany", { from }, [&]( token& t ) { t.sendmany( from, transfers, "" ); } );
+      });
+      add_move( 3, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const bool notify = below( 2 );
+         std::vector<std::pair<name, asset>> recipients;
+         for( const auto& to : some_holders( 4 ) ) {
+            recipients.emplace_back( to, asset( 1 + below( 500 ), sym ) );
+         }
+         push( notify ? "airdrop" : "distribute", { issuer }, [&]( token& t ) {
+            if( notify ) {
+               t.airdrop( issuer, recipients, "" );
+            } else {
+               t.distribute( issuer, recipients, "" );
+            }
+         });
+      });
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         std::vector<std::pair<name, asset>> burns;
+         for( const auto& from : some_holders( 3 ) ) {
+            burns.emplace_back( from, amount_for( from, sym ) );
+         }
+         push( "burnmany", { issuer }, [&]( token& t ) { t.burnmany( sym, burns ); } );
+      });
+      add_move( 2, [&]() {
+         const name payer = any_holder();
+         std::vector<std::pair<name, symbol>> balances;
+         for( const auto& owner : some_holders( 4 ) ) {
+            balances.emplace_back( owner, any_token().sym );
+         }
+         push( "claimmany", { payer }, [&]( token& t ) { t.claimmany( payer, balances ); } );
+      });
+      add_move( 1, [&]() {
+         const auto sym = any_token().sym;
+         const name ram_payer = any_holder();
+         const auto owners = some_holders( 3 );
+         push( "openmany", { ram_payer }, [&]( token& t ) { t.openmany( ram_payer, sym, owners ); } );
+      });
+      add_move( 1, [&]() {
+         const name owner = any_holder();
+         std::vector<symbol> symbols = { any_token().sym, any_token().sym };
+         push( "compact", { owner }, [&]( token& t ) { t.compact( owner, symbols ); } );
+      });
+      add_move( 1, [&]() {
+         //sorted chunks of the current or the next import
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         token::snapcursors snaptable( self, sym.code().raw() );
+         const uint64_t import_id = snaptable.get_or_default().import_id.value_or( 0 ) + below( 2 );
+         std::set<name> owners;
+         for( const auto& owner : some_holders( 4 ) ) {
+            owners.insert( owner );
+         }
+         std::vector<std::pair<name, int64_t>> balances;
+         for( const auto& owner : owners ) {
+            balances.emplace_back( owner, 1 + below( 1000 ) );
+         }
+         push( "loadsnap", { issuer }, [&]( token& t ) { t.loadsnap( sym, import_id, balances, name() ); } );
+      });
+#endif
+#if TOKEN_MERKLE_CLAIMS
+      std::map<uint64_t, merkle_tree> trees;
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         merkle_tree tree;
+         for( const auto& owner : some_holders( 1 ) ) {
+            tree.leaves.emplace_back( owner, asset( 1 + below( 100 ), sym ) );
+         }
+         for( size_t i = 0; i < 3; ++i ) {
+            tree.leaves.emplace_back( any_holder(), asset( 1 + below( 100 ), sym ) );
+         }
+         if( push( "setroot", { issuer }, [&]( token& t ) { t.setroot( sym, tree.root() ); } ) ) {
+            trees[sym.code().raw()] = tree;
+         }
+      });
+      add_move( 2, [&]() {
+         const auto sym = any_token().sym;
+         auto tree = trees.find( sym.code().raw() );
+         if( tree == trees.end() ) {
+            return;
+         }
+         const size_t leaf = below( 4 );
+         const name owner = tree->second.leaves[leaf].first;
+         const asset amount = tree->second.leaves[leaf].second;
+         const auto proof = tree->second.proof( leaf );
+         push( "claimproof", { owner }, [&]( token& t ) { t.claimproof( owner, amount, proof ); } );
+      });
+#endif
+#if TOKEN_VESTING
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const name to = any_holder();
+         const auto quantity = amount_for( issuer, sym );
+         const time_point_sec start{ uint32_t( current_time_point().sec_since_epoch() - 50 + below( 100 ) ) };
+         const uint32_t duration = below( 500 );
+         push( "grant", { issuer }, [&]( token& t ) { t.grant( issuer, to, quantity, start, duration, "" ); } );
+      });
+#endif
+#if TOKEN_EXPIRY
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const uint32_t seconds = below( 3 ) == 0 ? 0 : below( 300 );
+         push( "setwindow", { issuer }, [&]( token& t ) { t.setwindow( sym, seconds ); } );
+      });
+#endif
+#if TOKEN_SHARDED_SUPPLY
+      add_move( 1, [&]() {
+         const auto info = any_token();
+         const auto sym = info.sym;
+         const auto issuer = info.issuer;
+         const uint8_t shards = below( token::max_supply_shards + 2 );
+         push( "setshards", { issuer }, [&]( token& t ) { t.setshards( sym, shards ); } );
+      });
+#endif
+
+      for( uint64_t step = 0; step < steps; ++step ) {
+         context = "seed " + std::to_string( seed ) + " step " + std::to_string( step );
+         advance( below( 20 ) );
+         moves[below( moves.size() )]();
+         check_invariants();
+      }
+   }
+
+   void report_costs() {
+      std::cout << "database calls per successful action: find store update remove\n";
+      for( const auto& [action_name, cost] : costs ) {
+         auto per_run = [&]( uint64_t calls ) { return double( calls ) / cost.runs; };
+         std::cout << "  " << action_name << " x" << cost.runs << ": " << per_run( cost.finds ) << " "
+                   << per_run( cost.stores ) << " " << per_run( cost.updates ) << " " << per_run( cost.removes ) << "\n";
+      }
+   }
+
+} /// namespace
+
+//token_tests [random steps] [seed]
+int main( int argc, char** argv ) {
+   const uint64_t steps = argc > 1 ? std::strtoull( argv[1], nullptr, 10 ) : 2000;
+   const uint64_t seed  = argc > 2 ? std::strtoull( argv[2], nullptr, 10 ) : 1;
+
+   run_scenarios();
+   run_random( steps, seed );
+   report_costs();
+
+   std::cout << "all checks passed\n";
+   return 0;
+}